@@ -3,17 +3,103 @@
  *  @copyright defined in evt/LICENSE.txt
 */
 #include <evt/chain/block_log.hpp>
+#include <evt/chain/block_log_archive.hpp>
 #include <fc/io/raw.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
+#include <boost/noncopyable.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 #define LOG_READ (std::ios::in | std::ios::binary)
 #define LOG_WRITE (std::ios::out | std::ios::binary | std::ios::app)
 
 namespace evt { namespace chain {
 
-const uint32_t block_log::supported_version = 1;
+const uint32_t block_log::min_supported_version = 1;
+const uint32_t block_log::supported_version     = 2;
 
 namespace detail {
+
+namespace bip = boost::interprocess;
+
+/**
+ * Reads the header of block log, returns the version of log.
+ * Logs of version 1 always start from block 1, version 2 records the number of first block after the version,
+ * the blocks before it are moved into the archive.
+ */
+template <typename Stream>
+uint32_t
+read_log_header(Stream& ds, uint32_t& first_block_num, genesis_state& gs) {
+    uint32_t version = 0;
+    ds.read((char*)&version, sizeof(version));
+    FC_ASSERT(version > 0, "Block log was not setup properly with genesis information.");
+    FC_ASSERT(version >= block_log::min_supported_version && version <= block_log::supported_version,
+              "Unsupported version of block log. Block log version is ${version} while code supports version ${min} to ${max}",
+              ("version", version)("min", block_log::min_supported_version)("max", block_log::supported_version));
+
+    first_block_num = 1;
+    if(version >= 2) {
+        ds.read((char*)&first_block_num, sizeof(first_block_num));
+    }
+    fc::raw::unpack(ds, gs);
+    return version;
+}
+
+template <typename Stream>
+void
+write_log_header(Stream& ds, uint32_t version, uint32_t first_block_num, const genesis_state& gs) {
+    ds.write((char*)&version, sizeof(version));
+    if(version >= 2) {
+        ds.write((char*)&first_block_num, sizeof(first_block_num));
+    }
+    fc::raw::pack(ds, gs);
+}
+
+/**
+ * Read-only mapping of the flushed part of the block log and the index.
+ * A mapping never changes once created, readers keep it alive as long as they need it.
+ */
+class log_mapping : boost::noncopyable {
+public:
+    log_mapping(const fc::path& block_file, uint64_t block_size, const fc::path& index_file, uint64_t index_size)
+        : block_mapping(block_file.generic_string().c_str(), bip::read_only)
+        , index_mapping(index_file.generic_string().c_str(), bip::read_only) {
+        // region with zero size would map the whole file
+        if(block_size > 0) {
+            block_region = bip::mapped_region(block_mapping, bip::read_only, 0, block_size);
+        }
+        if(index_size > 0) {
+            index_region = bip::mapped_region(index_mapping, bip::read_only, 0, index_size);
+        }
+    }
+
+    const char*
+    block_data() const { return (const char*)block_region.get_address(); }
+
+    uint64_t
+    block_size() const { return block_region.get_size(); }
+
+    const char*
+    index_data() const { return (const char*)index_region.get_address(); }
+
+    uint64_t
+    index_size() const { return index_region.get_size(); }
+
+private:
+    bip::file_mapping  block_mapping;
+    bip::file_mapping  index_mapping;
+    bip::mapped_region block_region;
+    bip::mapped_region index_region;
+};
+
 class block_log_impl {
 public:
     signed_block_ptr head;
@@ -25,6 +111,174 @@ public:
     bool             block_write;
     bool             index_write;
     bool             genesis_written_to_block_log = false;
+    uint32_t         first_block_num              = 1;
+
+    std::unique_ptr<block_log_archive> archive;
+
+    // All the reads go through the mapping so they can be made from any thread without locks.
+    // The mapping is replaced by a larger one lazily when the files have grown since it was created.
+    std::shared_ptr<const log_mapping> mapping;
+    std::mutex                         mapping_mutex;
+    std::atomic<uint64_t>              flushed_block_size{0};
+    std::atomic<uint64_t>              flushed_index_size{0};
+
+    std::shared_ptr<const log_mapping>
+    get_mapping() {
+        auto block_size = flushed_block_size.load();
+        auto index_size = flushed_index_size.load();
+
+        auto m = std::atomic_load(&mapping);
+        if(m && m->block_size() >= block_size && m->index_size() >= index_size) {
+            return m;
+        }
+
+        std::lock_guard<std::mutex> lock(mapping_mutex);
+        m = std::atomic_load(&mapping);
+        if(m && m->block_size() >= block_size && m->index_size() >= index_size) {
+            return m;
+        }
+        if(block_size == 0) {
+            return nullptr;
+        }
+        m = std::make_shared<log_mapping>(block_file, block_size, index_file, index_size);
+        std::atomic_store(&mapping, m);
+        return m;
+    }
+
+    // only called when the files are recreated or truncated, readers may still hold the old mapping
+    void
+    reset_mapping() {
+        std::lock_guard<std::mutex> lock(mapping_mutex);
+        flushed_block_size = 0;
+        flushed_index_size = 0;
+        std::atomic_store(&mapping, std::shared_ptr<const log_mapping>());
+    }
+
+    void
+    update_flushed_size() {
+        flushed_block_size = fc::file_size(block_file);
+        flushed_index_size = fc::file_size(index_file);
+    }
+
+    // Blocks appended since the last flush, they are kept here until they are visible through the mapping.
+    std::deque<signed_block_ptr> unflushed_blocks;
+    std::mutex                   unflushed_mutex;
+    uint32_t                     flush_interval_blocks = 1;
+    fc::microseconds             flush_interval;
+    fc::time_point               last_flush;
+
+    signed_block_ptr
+    read_unflushed_block(uint32_t block_num) {
+        std::lock_guard<std::mutex> lock(unflushed_mutex);
+        if(unflushed_blocks.empty()) {
+            return nullptr;
+        }
+        auto first = unflushed_blocks.front()->block_num();
+        if(block_num < first || block_num - first >= unflushed_blocks.size()) {
+            return nullptr;
+        }
+        return unflushed_blocks[block_num - first];
+    }
+
+    bool
+    is_stale() const {
+        return !unflushed_blocks.empty() && fc::time_point::now() - last_flush >= flush_interval;
+    }
+
+    bool
+    should_flush() const {
+        return unflushed_blocks.size() >= flush_interval_blocks || is_stale();
+    }
+
+    static void
+    sync_file(const fc::path& file) {
+        auto fd = ::open(file.generic_string().c_str(), O_RDONLY);
+        if(fd < 0 || ::fsync(fd) != 0) {
+            elog("Failed to sync ${file} to disk: ${error}", ("file", file)("error", strerror(errno)));
+        }
+        if(fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    // Returns the end of the block starting at `pos` including its trailing position, or 0 if it's incomplete.
+    static uint64_t
+    validate_block(const log_mapping& m, uint64_t pos) {
+        if(pos >= m.block_size()) {
+            return 0;
+        }
+        try {
+            auto ds = fc::datastream<const char*>(m.block_data() + pos, m.block_size() - pos);
+            auto b  = signed_block();
+            fc::raw::unpack(ds, b);
+
+            uint64_t tail_pos;
+            ds.read((char*)&tail_pos, sizeof(tail_pos));
+            if(tail_pos != pos) {
+                return 0;
+            }
+            return pos + ds.tellp();
+        }
+        catch(...) {
+            return 0;
+        }
+    }
+
+    /**
+     * Blocks are not synced to disk when they are appended, so a crash can leave a partially written block
+     * at the end of the log. Find the last complete block by following the trailing positions and truncate
+     * the log right after it. Index is fixed later by comparing its head with the log's.
+     */
+    void
+    recover_torn_tail() {
+        uint64_t end = 0;
+        {
+            auto m = get_mapping();
+            FC_ASSERT(m);
+
+            auto ds = fc::datastream<const char*>(m->block_data(), m->block_size());
+            auto gs = genesis_state();
+            read_log_header(ds, first_block_num, gs);
+            auto first_block_pos = (uint64_t)ds.tellp();
+
+            auto size = m->block_size();
+            if(size >= first_block_pos + sizeof(uint64_t)) {
+                uint64_t pos;
+                memcpy(&pos, m->block_data() + size - sizeof(pos), sizeof(pos));
+                if(validate_block(*m, pos) == size) {
+                    return;
+                }
+            }
+            wlog("Block log has an incomplete tail, searching for the last complete block");
+
+            // start from the last block recorded in the index which is still complete, index may be ahead of the log
+            auto start         = first_block_pos;
+            auto index_entries = m->index_size() / sizeof(uint64_t);
+            for(auto i = index_entries; i > 0 && index_entries - i < 1024; i--) {
+                uint64_t pos;
+                memcpy(&pos, m->index_data() + (i - 1) * sizeof(pos), sizeof(pos));
+                if(validate_block(*m, pos)) {
+                    start = pos;
+                    break;
+                }
+            }
+
+            end = start;
+            while(auto next = validate_block(*m, end)) {
+                end = next;
+            }
+            FC_ASSERT(end > first_block_pos, "Block log doesn't have any complete block, try with --hard-replay-blockchain");
+            wlog("Truncate block log from ${size} bytes to ${end} bytes", ("size", size)("end", end));
+        }
+
+        // all the mappings must be released before the file is truncated
+        reset_mapping();
+        block_stream.close();
+        fc::resize_file(block_file, end);
+        block_stream.open(block_file.generic_string().c_str(), LOG_WRITE);
+        block_write = true;
+        update_flushed_size();
+    }
 
     inline void
     check_block_read() {
@@ -67,10 +321,16 @@ public:
 };
 }  // namespace detail
 
-block_log::block_log(const fc::path& data_dir)
+block_log::block_log(const fc::path& data_dir, uint32_t flush_interval_blocks, uint32_t flush_interval_ms,
+                     const fc::path& archive_dir)
     : my(new detail::block_log_impl()) {
     my->block_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
     my->index_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+    my->flush_interval_blocks = std::max(flush_interval_blocks, 1u);
+    my->flush_interval        = fc::milliseconds(flush_interval_ms);
+    if(!archive_dir.generic_string().empty()) {
+        my->archive = std::make_unique<block_log_archive>(archive_dir);
+    }
     open(data_dir);
 }
 
@@ -81,6 +341,8 @@ block_log::block_log(block_log&& other) {
 block_log::~block_log() {
     if(my) {
         flush();
+        my->sync_file(my->block_file);
+        my->sync_file(my->index_file);
         my.reset();
     }
 }
@@ -103,6 +365,9 @@ block_log::open(const fc::path& data_dir) {
     my->block_write = true;
     my->index_write = true;
 
+    my->reset_mapping();
+    my->update_flushed_size();
+
     /* On startup of the block log, there are several states the log file and the index file can be
        * in relation to each other.
        *
@@ -128,19 +393,20 @@ block_log::open(const fc::path& data_dir) {
         ilog("Log is nonempty");
         my->check_block_read();
         my->block_stream.seekg(0);
-        uint32_t version = 0;
-        my->block_stream.read((char*)&version, sizeof(version));
-        FC_ASSERT(version > 0, "Block log was not setup properly with genesis information.");
-        FC_ASSERT(version == block_log::supported_version,
-                  "Unsupported version of block log. Block log version is ${version} while code supports version ${supported}",
-                  ("version", version)("supported", block_log::supported_version));
+        genesis_state gs;
+        detail::read_log_header(my->block_stream, my->first_block_num, gs);
 
         my->genesis_written_to_block_log = true;  // Assume it was constructed properly.
+        my->recover_torn_tail();
         my->head                         = read_head();
         my->head_id                      = my->head->id();
         edump((my->head->block_num()));
 
-        if(index_size) {
+        if(index_size % sizeof(uint64_t)) {
+            ilog("Index has an incomplete entry");
+            construct_index();
+        }
+        else if(index_size) {
             my->check_block_read();
             my->check_index_read();
 
@@ -174,6 +440,7 @@ block_log::open(const fc::path& data_dir) {
         my->index_stream.open(my->index_file.generic_string().c_str(), LOG_WRITE);
         my->index_write = true;
     }
+    flush();
 }
 
 uint64_t
@@ -185,17 +452,23 @@ block_log::append(const signed_block_ptr& b) {
         my->check_index_write();
 
         uint64_t pos = my->block_stream.tellp();
-        FC_ASSERT(my->index_stream.tellp() == sizeof(uint64_t) * (b->block_num() - 1),
+        FC_ASSERT(my->index_stream.tellp() == sizeof(uint64_t) * (b->block_num() - my->first_block_num),
                   "Append to index file occuring at wrong position.",
-                  ("position", (uint64_t)my->index_stream.tellp())("expected", (b->block_num() - 1) * sizeof(uint64_t)));
-        auto data = fc::raw::pack(*b);
-        my->block_stream.write(data.data(), data.size());
+                  ("position", (uint64_t)my->index_stream.tellp())("expected", (b->block_num() - my->first_block_num) * sizeof(uint64_t)));
+        // pack into the buffer of stream directly, data is written to disk when the stream is flushed
+        fc::raw::pack(my->block_stream, *b);
         my->block_stream.write((char*)&pos, sizeof(pos));
         my->index_stream.write((char*)&pos, sizeof(pos));
         my->head    = b;
         my->head_id = b->id();
 
-        flush();
+        {
+            std::lock_guard<std::mutex> lock(my->unflushed_mutex);
+            my->unflushed_blocks.emplace_back(b);
+        }
+        if(my->should_flush()) {
+            flush();
+        }
 
         return pos;
     }
@@ -206,6 +479,28 @@ void
 block_log::flush() {
     my->block_stream.flush();
     my->index_stream.flush();
+    my->update_flushed_size();
+    my->last_flush = fc::time_point::now();
+
+    // flushed blocks are readable from the mapping now
+    std::lock_guard<std::mutex> lock(my->unflushed_mutex);
+    my->unflushed_blocks.clear();
+}
+
+void
+block_log::flush_if_stale() {
+    if(my->is_stale()) {
+        flush();
+    }
+}
+
+uint32_t
+block_log::flushed_block_num() const {
+    if(!my->head) {
+        return 0;
+    }
+    // only appends and flushes change it, both are made by the owner
+    return my->head->block_num() - my->unflushed_blocks.size();
 }
 
 uint64_t
@@ -215,6 +510,11 @@ block_log::reset_to_genesis(const genesis_state& gs, const signed_block_ptr& gen
     if(my->index_stream.is_open())
         my->index_stream.close();
 
+    my->reset_mapping();
+    {
+        std::lock_guard<std::mutex> lock(my->unflushed_mutex);
+        my->unflushed_blocks.clear();
+    }
     fc::remove_all(my->block_file);
     fc::remove_all(my->index_file);
 
@@ -223,10 +523,13 @@ block_log::reset_to_genesis(const genesis_state& gs, const signed_block_ptr& gen
     my->block_write = true;
     my->index_write = true;
 
-    auto     data    = fc::raw::pack(gs);
-    uint32_t version = 0;  // version of 0 is invalid; it indicates that the genesis was not properly written to the block log
+    auto     data            = fc::raw::pack(gs);
+    uint32_t version         = 0;  // version of 0 is invalid; it indicates that the genesis was not properly written to the block log
+    uint32_t first_block_num = 1;
     my->block_stream.write((char*)&version, sizeof(version));
+    my->block_stream.write((char*)&first_block_num, sizeof(first_block_num));
     my->block_stream.write(data.data(), data.size());
+    my->first_block_num              = first_block_num;
     my->genesis_written_to_block_log = true;
 
     auto ret = append(genesis_block);
@@ -251,21 +554,31 @@ block_log::reset_to_genesis(const genesis_state& gs, const signed_block_ptr& gen
 
 std::pair<signed_block_ptr, uint64_t>
 block_log::read_block(uint64_t pos) const {
-    my->check_block_read();
+    auto m = my->get_mapping();
+    FC_ASSERT(m && pos < m->block_size(), "Position ${pos} is out of the block log", ("pos", pos));
 
-    my->block_stream.seekg(pos);
+    // unpack directly from the mapped memory
+    auto ds = fc::datastream<const char*>(m->block_data() + pos, m->block_size() - pos);
     std::pair<signed_block_ptr, uint64_t> result;
     result.first = std::make_shared<signed_block>();
-    fc::raw::unpack(my->block_stream, *result.first);
-    result.second = uint64_t(my->block_stream.tellg()) + 8;
+    fc::raw::unpack(ds, *result.first);
+    result.second = pos + ds.tellp() + sizeof(uint64_t);
     return result;
 }
 
 signed_block_ptr
 block_log::read_block_by_num(uint32_t block_num) const {
     try {
-        signed_block_ptr b;
-        uint64_t         pos = get_block_pos(block_num);
+        if(block_num < my->first_block_num) {
+            return my->archive ? my->archive->read_block_by_num(block_num) : signed_block_ptr();
+        }
+
+        // check unflushed blocks first, they are moved into the mapping by flush
+        signed_block_ptr b = my->read_unflushed_block(block_num);
+        if(b) {
+            return b;
+        }
+        uint64_t pos = get_block_pos(block_num);
         if(pos != npos) {
             b = read_block(pos).first;
             FC_ASSERT(b->block_num() == block_num,
@@ -278,29 +591,35 @@ block_log::read_block_by_num(uint32_t block_num) const {
 
 uint64_t
 block_log::get_block_pos(uint32_t block_num) const {
-    my->check_index_read();
+    if(block_num < my->first_block_num)
+        return npos;
 
-    if(!(my->head && block_num <= block_header::num_from_id(my->head_id) && block_num > 0))
+    auto m = my->get_mapping();
+    if(!m || m->index_size() < sizeof(uint64_t) * (block_num - my->first_block_num + 1))
         return npos;
-    my->index_stream.seekg(sizeof(uint64_t) * (block_num - 1));
+
     uint64_t pos;
-    my->index_stream.read((char*)&pos, sizeof(pos));
+    memcpy(&pos, m->index_data() + sizeof(uint64_t) * (block_num - my->first_block_num), sizeof(pos));
     return pos;
 }
 
 signed_block_ptr
 block_log::read_head() const {
-    my->check_block_read();
+    {
+        std::lock_guard<std::mutex> lock(my->unflushed_mutex);
+        if(!my->unflushed_blocks.empty()) {
+            return my->unflushed_blocks.back();
+        }
+    }
 
     uint64_t pos;
 
     // Check that the file is not empty
-    my->block_stream.seekg(0, std::ios::end);
-    if(my->block_stream.tellg() <= sizeof(pos))
+    auto m = my->get_mapping();
+    if(!m || m->block_size() <= sizeof(pos))
         return {};
 
-    my->block_stream.seekg(-sizeof(pos), std::ios::end);
-    my->block_stream.read((char*)&pos, sizeof(pos));
+    memcpy(&pos, m->block_data() + m->block_size() - sizeof(pos), sizeof(pos));
     return read_block(pos).first;
 }
 
@@ -312,6 +631,7 @@ block_log::head() const {
 void
 block_log::construct_index() {
     ilog("Reconstructing Block Log Index...");
+    my->reset_mapping();
     my->index_stream.close();
     fc::remove_all(my->index_file);
     my->index_stream.open(my->index_file.generic_string().c_str(), LOG_WRITE);
@@ -324,11 +644,11 @@ block_log::construct_index() {
     my->block_stream.read((char*)&end_pos, sizeof(end_pos));
     signed_block tmp;
 
-    uint64_t pos = 4;  // Skip version which should have already been checked.
+    uint64_t pos = 0;
     my->block_stream.seekg(pos);
 
     genesis_state gs;
-    fc::raw::unpack(my->block_stream, gs);
+    detail::read_log_header(my->block_stream, my->first_block_num, gs);
 
     while(pos < end_pos) {
         fc::raw::unpack(my->block_stream, tmp);
@@ -376,19 +696,11 @@ block_log::repair_log(const fc::path& data_dir, uint32_t truncate_at_block) {
     uint64_t end_pos = old_block_stream.tellg();
     old_block_stream.seekg(0);
 
-    uint32_t version = 0;
-    old_block_stream.read((char*)&version, sizeof(version));
-    FC_ASSERT(version > 0, "Block log was not setup properly with genesis information.");
-    FC_ASSERT(version == block_log::supported_version,
-              "Unsupported version of block log. Block log version is ${version} while code supports version ${supported}",
-              ("version", version)("supported", block_log::supported_version));
-
     genesis_state gs;
-    fc::raw::unpack(old_block_stream, gs);
+    uint32_t      first_block_num = 1;
+    auto          version         = detail::read_log_header(old_block_stream, first_block_num, gs);
 
-    auto data = fc::raw::pack(gs);
-    new_block_stream.write((char*)&version, sizeof(version));
-    new_block_stream.write(data.data(), data.size());
+    detail::write_log_header(new_block_stream, version, first_block_num, gs);
 
     std::exception_ptr     except_ptr;
     vector<char>           incomplete_block_data;
@@ -412,6 +724,10 @@ block_log::repair_log(const fc::path& data_dir, uint32_t truncate_at_block) {
         }
 
         auto id = tmp.id();
+        if(block_header::num_from_id(id) == first_block_num) {
+            // blocks before the first one are in the archive
+            previous = tmp.previous;
+        }
         if(block_header::num_from_id(previous) + 1 != block_header::num_from_id(id)) {
             elog("Block ${num} (${id}) skips blocks. Previous block in block log is block ${prev_num} (${previous})",
                  ("num", block_header::num_from_id(id))("id", id)("prev_num", block_header::num_from_id(previous))("previous", previous));
@@ -486,6 +802,77 @@ block_log::repair_log(const fc::path& data_dir, uint32_t truncate_at_block) {
     return backup_dir;
 }
 
+uint32_t
+block_log::archive_log(const fc::path& data_dir, const fc::path& archive_dir, uint32_t blocks_per_segment) {
+    ilog("Archiving Block Log...");
+    FC_ASSERT(fc::is_directory(data_dir) && fc::is_regular_file(data_dir / "blocks.log"),
+              "Block log not found in '${blocks_dir}'", ("blocks_dir", data_dir));
+    FC_ASSERT(blocks_per_segment > 0, "Size of block log segment cannot be zero");
+
+    auto gs             = extract_genesis_state(data_dir);
+    auto block_log_path = data_dir / "blocks.log";
+    auto tmp_log_path   = data_dir / "blocks.log.tmp";
+
+    uint32_t first_block_num = 0;
+    uint32_t new_first_num   = 0;
+    {
+        // opening the log recovers its tail and index, so all the blocks can be located by index
+        block_log log(data_dir);
+        FC_ASSERT(log.head(), "Block log is empty");
+
+        auto m          = log.my->get_mapping();
+        auto head_num   = log.head()->block_num();
+        first_block_num = log.my->first_block_num;
+
+        auto read_block = [&](uint32_t num) -> std::pair<const char*, size_t> {
+            auto pos = log.get_block_pos(num);
+            auto end = (num == head_num) ? m->block_size() : log.get_block_pos(num + 1);
+            FC_ASSERT(pos != npos && end != npos && pos + sizeof(uint64_t) < end, "Cannot locate block ${num} in block log", ("num", num));
+            // trailing position is not part of block
+            return std::make_pair(m->block_data() + pos, end - pos - sizeof(uint64_t));
+        };
+
+        // head block always stays in the log
+        new_first_num = first_block_num;
+        while(new_first_num + blocks_per_segment - 1 < head_num) {
+            auto file = block_log_archive::write_segment(archive_dir, new_first_num, blocks_per_segment,
+                                                         config::blocks_archive_frame_size, config::blocks_archive_compression_level,
+                                                         read_block);
+            ilog("Archived blocks from ${first} to ${last} into '${file}'",
+                 ("first", new_first_num)("last", new_first_num + blocks_per_segment - 1)("file", file));
+            new_first_num += blocks_per_segment;
+        }
+        if(new_first_num == first_block_num) {
+            ilog("No full segment of blocks to archive, block log starts from ${first} and ends at ${head}",
+                 ("first", first_block_num)("head", head_num));
+            return first_block_num;
+        }
+
+        // rewrite the remaining blocks into a new log, their positions are changed
+        std::fstream new_block_stream;
+        new_block_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+        new_block_stream.open(tmp_log_path.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+        detail::write_log_header(new_block_stream, block_log::supported_version, new_first_num, gs);
+        for(auto num = new_first_num; num <= head_num; num++) {
+            auto     data = read_block(num);
+            uint64_t pos  = new_block_stream.tellp();
+            new_block_stream.write(data.first, data.second);
+            new_block_stream.write((char*)&pos, sizeof(pos));
+        }
+        new_block_stream.close();
+        detail::block_log_impl::sync_file(tmp_log_path);
+    }
+
+    // index is reconstructed when the log is opened next time
+    fc::remove_all(data_dir / "blocks.index");
+    fc::rename(tmp_log_path, block_log_path);
+
+    ilog("Block log starts from block ${num} now, blocks before it are moved into '${archive_dir}'",
+         ("num", new_first_num)("archive_dir", archive_dir));
+    return new_first_num;
+}
+
 genesis_state
 block_log::extract_genesis_state(const fc::path& data_dir) {
     FC_ASSERT(fc::is_directory(data_dir) && fc::is_regular_file(data_dir / "blocks.log"),
@@ -494,15 +881,9 @@ block_log::extract_genesis_state(const fc::path& data_dir) {
     std::fstream block_stream;
     block_stream.open((data_dir / "blocks.log").generic_string().c_str(), LOG_READ);
 
-    uint32_t version = 0;
-    block_stream.read((char*)&version, sizeof(version));
-    FC_ASSERT(version > 0, "Block log was not setup properly with genesis information.");
-    FC_ASSERT(version == block_log::supported_version,
-              "Unsupported version of block log. Block log version is ${version} while code supports version ${supported}",
-              ("version", version)("supported", block_log::supported_version));
-
     genesis_state gs;
-    fc::raw::unpack(block_stream, gs);
+    uint32_t      first_block_num = 1;
+    detail::read_log_header(block_stream, first_block_num, gs);
     return gs;
 }
 
@@ -0,0 +1,259 @@
+/**
+ *  @file
+ *  @copyright defined in evt/LICENSE.txt
+ */
+#include <evt/chain/block_log_archive.hpp>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <fc/io/raw.hpp>
+#include <zstd.h>
+
+namespace evt { namespace chain { namespace detail {
+
+struct segment_footer {
+    uint32_t         first_block_num;
+    uint32_t         block_count;
+    uint32_t         blocks_per_frame;
+    vector<uint64_t> frame_offsets;  // offset of each frame in file, followed by the end of last frame
+    vector<uint32_t> block_offsets;  // offset of each block in its decompressed frame
+};
+
+}}}  // namespace evt::chain::detail
+
+FC_REFLECT(evt::chain::detail::segment_footer, (first_block_num)(block_count)(blocks_per_frame)(frame_offsets)(block_offsets));
+
+namespace evt { namespace chain {
+
+namespace detail {
+
+namespace bip = boost::interprocess;
+
+class block_log_segment : boost::noncopyable {
+public:
+    block_log_segment(const fc::path& file)
+        : mapping_(file.generic_string().c_str(), bip::read_only)
+        , region_(mapping_, bip::read_only) {
+        auto data = (const char*)region_.get_address();
+        auto size = region_.get_size();
+        FC_ASSERT(size > sizeof(uint64_t), "Block log segment ${file} is too small", ("file", file));
+
+        uint64_t footer_pos;
+        memcpy(&footer_pos, data + size - sizeof(footer_pos), sizeof(footer_pos));
+        FC_ASSERT(footer_pos < size - sizeof(footer_pos), "Invalid footer position in block log segment ${file}", ("file", file));
+
+        auto ds = fc::datastream<const char*>(data + footer_pos, size - sizeof(footer_pos) - footer_pos);
+        fc::raw::unpack(ds, footer_);
+
+        auto frame_count = (footer_.block_count + footer_.blocks_per_frame - 1) / std::max(footer_.blocks_per_frame, 1u);
+        FC_ASSERT(footer_.blocks_per_frame > 0 && footer_.block_offsets.size() == footer_.block_count
+                      && footer_.frame_offsets.size() == frame_count + 1 && footer_.frame_offsets.back() == footer_pos,
+                  "Footer of block log segment ${file} is corrupted", ("file", file));
+    }
+
+public:
+    signed_block_ptr
+    read_block(uint32_t block_num) const {
+        // range in file name is not trusted, the footer decides which blocks are in the segment
+        FC_ASSERT(block_num >= footer_.first_block_num && block_num - footer_.first_block_num < footer_.block_count,
+                  "Block ${num} is not in block log segment", ("num", block_num));
+
+        auto i     = block_num - footer_.first_block_num;
+        auto frame = i / footer_.blocks_per_frame;
+        FC_ASSERT(frame + 1 < footer_.frame_offsets.size(), "Invalid frame for block ${num} in block log segment", ("num", block_num));
+        auto buf   = read_frame(frame, block_num);
+
+        auto offset = footer_.block_offsets[i];
+        FC_ASSERT(offset < buf->size(), "Invalid offset of block ${num} in block log segment", ("num", block_num));
+
+        auto ds = fc::datastream<const char*>(buf->data() + offset, buf->size() - offset);
+        auto b  = std::make_shared<signed_block>();
+        fc::raw::unpack(ds, *b);
+        return b;
+    }
+
+private:
+    using frame_ptr = std::shared_ptr<const std::vector<char>>;
+
+    // the last decompressed frame is kept, blocks are mostly read one after another when replaying or syncing
+    frame_ptr
+    read_frame(uint32_t frame, uint32_t block_num) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(last_frame_ && last_frame_num_ == frame) {
+            return last_frame_;
+        }
+
+        auto begin = footer_.frame_offsets[frame];
+        auto end   = footer_.frame_offsets[frame + 1];
+        auto data  = (const char*)region_.get_address() + begin;
+
+        auto size = ZSTD_getFrameContentSize(data, end - begin);
+        FC_ASSERT(size != ZSTD_CONTENTSIZE_ERROR && size != ZSTD_CONTENTSIZE_UNKNOWN,
+                  "Invalid frame for block ${num} in block log segment", ("num", block_num));
+
+        auto buf = std::make_shared<std::vector<char>>(size);
+        auto r   = ZSTD_decompress(buf->data(), buf->size(), data, end - begin);
+        FC_ASSERT(!ZSTD_isError(r) && r == size, "Failed to decompress the frame of block ${num}: ${error}",
+                  ("num", block_num)("error", ZSTD_isError(r) ? ZSTD_getErrorName(r) : "size mismatch"));
+
+        last_frame_num_ = frame;
+        last_frame_     = buf;
+        return last_frame_;
+    }
+
+private:
+    bip::file_mapping  mapping_;
+    bip::mapped_region region_;
+    segment_footer     footer_;
+
+    mutable std::mutex mutex_;
+    mutable uint32_t   last_frame_num_ = 0;
+    mutable frame_ptr  last_frame_;
+};
+
+std::string
+segment_file_name(uint32_t first_block_num, uint32_t last_block_num) {
+    char name[64];
+    snprintf(name, sizeof(name), "blocks-%010u-%010u.seg", first_block_num, last_block_num);
+    return name;
+}
+
+void
+sync_file(const fc::path& file) {
+    auto fd = ::open(file.generic_string().c_str(), O_RDONLY);
+    FC_ASSERT(fd >= 0, "Failed to open ${file}", ("file", file));
+    auto r = ::fsync(fd);
+    ::close(fd);
+    FC_ASSERT(r == 0, "Failed to sync ${file} to disk", ("file", file));
+}
+
+}  // namespace detail
+
+block_log_archive::block_log_archive(const fc::path& archive_dir)
+    : archive_dir_(archive_dir) {
+    if(!fc::is_directory(archive_dir_)) {
+        return;
+    }
+    for(auto it = fc::directory_iterator(archive_dir_); it != fc::directory_iterator(); it++) {
+        uint32_t first = 0, last = 0;
+
+        // skip unrelated files and the temporary ones left by interrupted archiving
+        auto name = (*it).filename().generic_string();
+        if(sscanf(name.c_str(), "blocks-%u-%u", &first, &last) != 2 || first > last
+           || name != detail::segment_file_name(first, last)) {
+            continue;
+        }
+        segment_files_.emplace(first, std::make_pair(last, *it));
+    }
+    if(!segment_files_.empty()) {
+        ilog("Found ${n} block log segments in archive, blocks from ${first} to ${last}",
+             ("n", segment_files_.size())("first", segment_files_.begin()->first)("last", segment_files_.rbegin()->second.first));
+    }
+}
+
+block_log_archive::~block_log_archive() {}
+
+signed_block_ptr
+block_log_archive::read_block_by_num(uint32_t block_num) const {
+    try {
+        auto segment = get_segment(block_num);
+        if(!segment) {
+            return nullptr;
+        }
+        auto b = segment->read_block(block_num);
+        FC_ASSERT(b->block_num() == block_num,
+                  "Wrong block was read from block log segment.", ("returned", b->block_num())("expected", block_num));
+        return b;
+    }
+    FC_LOG_AND_RETHROW()
+}
+
+std::shared_ptr<detail::block_log_segment>
+block_log_archive::get_segment(uint32_t block_num) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = segment_files_.upper_bound(block_num);
+    if(it == segment_files_.begin()) {
+        return nullptr;
+    }
+    --it;
+    if(block_num > it->second.first) {
+        return nullptr;
+    }
+
+    if(!fc::exists(it->second.second)) {
+        // segment is pruned or moved away, the mapping of an opened one is released too
+        segments_.erase(it->first);
+        segment_files_.erase(it);
+        return nullptr;
+    }
+    auto sit = segments_.find(it->first);
+    if(sit != segments_.end()) {
+        return sit->second;
+    }
+    auto segment = std::make_shared<detail::block_log_segment>(it->second.second);
+    segments_.emplace(it->first, segment);
+    return segment;
+}
+
+fc::path
+block_log_archive::write_segment(const fc::path& archive_dir, uint32_t first_block_num, uint32_t block_count,
+                                 uint32_t blocks_per_frame, int compression_level,
+                                 const std::function<std::pair<const char*, size_t>(uint32_t)>& read_block) {
+    FC_ASSERT(block_count > 0 && blocks_per_frame > 0);
+    if(!fc::is_directory(archive_dir)) {
+        fc::create_directories(archive_dir);
+    }
+
+    auto file     = archive_dir / detail::segment_file_name(first_block_num, first_block_num + block_count - 1);
+    auto tmp_file = archive_dir / (detail::segment_file_name(first_block_num, first_block_num + block_count - 1) + ".tmp");
+
+    std::ofstream out;
+    out.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+    out.open(tmp_file.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+    auto footer             = detail::segment_footer();
+    footer.first_block_num  = first_block_num;
+    footer.block_count      = block_count;
+    footer.blocks_per_frame = blocks_per_frame;
+    footer.block_offsets.reserve(block_count);
+
+    auto     frame      = std::vector<char>();
+    auto     compressed = std::vector<char>();
+    uint64_t pos        = 0;
+    for(auto i = 0u; i < block_count; i++) {
+        auto data = read_block(first_block_num + i);
+        footer.block_offsets.emplace_back(frame.size());
+        frame.insert(frame.end(), data.first, data.first + data.second);
+
+        if((i + 1) % blocks_per_frame != 0 && i + 1 != block_count) {
+            continue;
+        }
+        compressed.resize(ZSTD_compressBound(frame.size()));
+        auto r = ZSTD_compress(compressed.data(), compressed.size(), frame.data(), frame.size(), compression_level);
+        FC_ASSERT(!ZSTD_isError(r), "Failed to compress blocks: ${error}", ("error", ZSTD_getErrorName(r)));
+
+        out.write(compressed.data(), r);
+        footer.frame_offsets.emplace_back(pos);
+        pos += r;
+        frame.clear();
+    }
+    footer.frame_offsets.emplace_back(pos);
+
+    auto data = fc::raw::pack(footer);
+    out.write(data.data(), data.size());
+    out.write((char*)&pos, sizeof(pos));
+    out.close();
+
+    // source blocks may be removed as soon as this returns
+    detail::sync_file(tmp_file);
+    fc::rename(tmp_file, file);
+    return file;
+}
+
+}}  // namespace evt::chain
@@ -7,6 +7,7 @@
 #include <evt/chain/contracts/abi_serializer.hpp>
 #include <evt/chain/contracts/types.hpp>
 #include <evt/chain/transaction.hpp>
+#include <fc/io/json.hpp>
 #include <fc/io/raw.hpp>
 #include <fc/io/varint.hpp>
 
@@ -17,6 +18,189 @@ namespace evt { namespace chain { namespace contracts {
 using boost::algorithm::ends_with;
 using std::string;
 
+namespace __internal {
+
+// binaries of values are written here first and copied out, it's reused by the calls of one thread
+// rather than zero filling a new buffer each time, 1MB is still the limit of one value
+fc::datastream<char*>
+scratch_stream() {
+    thread_local auto temp = std::vector<char>(1024 * 1024);
+    return fc::datastream<char*>(temp.data(), temp.size());
+}
+
+template <typename Func>
+void
+pack_to(bytes& binary, Func&& pack) {
+    auto ds    = scratch_stream();
+    auto start = ds.pos();
+    pack(ds);
+    binary.insert(binary.end(), start, ds.pos());
+}
+
+const char*
+skip_whitespace(const char* p, const char* end) {
+    while(p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+// returns the end of the value which starts at `p`, only the nesting is checked here,
+// leaves are validated by fc::json when they're converted
+const char*
+skip_value(const char* p, const char* end, uint32_t depth) {
+    if(p == end) {
+        FC_THROW_EXCEPTION(parse_error_exception, "Unexpected end of JSON");
+    }
+    switch(*p) {
+    case '"': {
+        for(p++; p < end; p++) {
+            if(*p == '\\') {
+                p++;
+            }
+            else if(*p == '"') {
+                return p + 1;
+            }
+        }
+        FC_THROW_EXCEPTION(parse_error_exception, "Unterminated JSON string");
+    }
+    case '{':
+    case '[': {
+        if(depth >= 200) {
+            FC_THROW_EXCEPTION(parse_error_exception, "JSON is nested too deep");
+        }
+        auto is_object = (*p == '{');
+        auto close     = is_object ? '}' : ']';
+
+        p = skip_whitespace(p + 1, end);
+        if(p < end && *p == close) {
+            return p + 1;
+        }
+        while(true) {
+            if(is_object) {
+                if(p == end || *p != '"') {
+                    FC_THROW_EXCEPTION(parse_error_exception, "Expected key of JSON object");
+                }
+                p = skip_whitespace(skip_value(p, end, depth), end);
+                if(p == end || *p != ':') {
+                    FC_THROW_EXCEPTION(parse_error_exception, "Expected ':' after key of JSON object");
+                }
+                p = skip_whitespace(p + 1, end);
+            }
+            p = skip_whitespace(skip_value(p, end, depth + 1), end);
+            if(p < end && *p == ',') {
+                p = skip_whitespace(p + 1, end);
+                continue;
+            }
+            if(p < end && *p == close) {
+                return p + 1;
+            }
+            FC_THROW_EXCEPTION(parse_error_exception, "Expected ',' or '${c}' in JSON", ("c", std::string(1, close)));
+        }
+    }
+    default: {
+        // numbers and other tokens end at the next delimiter
+        auto begin = p;
+        while(p < end && *p != ',' && *p != ':' && *p != ']' && *p != '}' && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') {
+            p++;
+        }
+        if(p == begin) {
+            FC_THROW_EXCEPTION(parse_error_exception, "Unexpected character '${c}' in JSON", ("c", std::string(1, *p)));
+        }
+        return p;
+    }
+    }  // switch
+}
+
+// calls `func` with the slice of each element, or each key and value of objects
+template <typename Func>
+void
+visit_elements(const impl::json_slice& json, bool is_object, Func&& func) {
+    auto p   = skip_whitespace(json.begin + 1, json.end);
+    auto end = json.end - 1;
+    while(p < end) {
+        auto key = impl::json_slice();
+        if(is_object) {
+            key.begin = p;
+            key.end   = skip_value(p, end, 0);
+            p         = skip_whitespace(skip_whitespace(key.end, end) + 1, end);
+        }
+        auto value  = impl::json_slice();
+        value.begin = p;
+        value.end   = skip_value(p, end, 0);
+        func(key, value);
+        p = skip_whitespace(skip_whitespace(value.end, end) + 1, end);
+    }
+}
+
+}  // namespace __internal
+
+namespace impl {
+
+const json_slice*
+json_object::find(const char* key) const {
+    auto len = strlen(key);
+    for(const auto& m : members) {
+        const auto& k = m.first;
+        if(std::find(k.begin, k.end, '\\') != k.end) {
+            if(json_to_variant(k).get_string() == key) {
+                return &m.second;
+            }
+        }
+        else if((size_t)(k.end - k.begin) == len + 2 && memcmp(k.begin + 1, key, len) == 0) {
+            return &m.second;
+        }
+    }
+    return nullptr;
+}
+
+json_slice
+json_parse(const string& json) {
+    auto end   = json.data() + json.size();
+    auto slice = json_slice();
+
+    slice.begin = __internal::skip_whitespace(json.data(), end);
+    slice.end   = __internal::skip_value(slice.begin, end, 0);
+    return slice;
+}
+
+json_object
+json_parse_object(const json_slice& json) {
+    FC_ASSERT(json.is_object(), "Expected JSON object: ${json}", ("json", json));
+
+    auto obj = json_object();
+    __internal::visit_elements(json, true, [&](auto& k, auto& v) {
+        obj.members.emplace_back(k, v);
+    });
+    return obj;
+}
+
+vector<json_slice>
+json_parse_array(const json_slice& json) {
+    FC_ASSERT(json.is_array(), "Expected JSON array: ${json}", ("json", json));
+
+    auto array = vector<json_slice>();
+    __internal::visit_elements(json, false, [&](auto&, auto& v) {
+        array.emplace_back(v);
+    });
+    return array;
+}
+
+fc::variant
+json_to_variant(const json_slice& json) {
+    if(json.is_string() && std::find(json.begin, json.end, '\\') == json.end) {
+        return fc::variant(std::string(json.begin + 1, json.end - 1));
+    }
+    return fc::json::from_string(std::string(json.begin, json.end));
+}
+
+void
+to_variant(const json_slice& json, fc::variant& v) {
+    v = std::string(json.begin, json.end);
+}
+
+}  // namespace impl
+
 template <typename T>
 inline fc::variant
 variant_from_stream(fc::datastream<const char*>& stream) {
@@ -121,6 +305,98 @@ abi_serializer::set_abi(const abi_def& abi) {
     FC_ASSERT(actions.size() == abi.actions.size());
 
     validate();
+    compile_plans();
+}
+
+void
+abi_serializer::compile_plans() {
+    auto p = type_plans();
+    for(const auto& bt : built_in_types) {
+        compile_plan(p, bt.first);
+        compile_plan(p, bt.first + "[]");
+        compile_plan(p, bt.first + "?");
+    }
+    for(const auto& td : typedefs) {
+        compile_plan(p, td.first);
+    }
+    for(const auto& st : structs) {
+        compile_plan(p, st.first);
+    }
+    for(const auto& a : actions) {
+        compile_plan(p, a.second);
+    }
+    plans = std::move(p);
+}
+
+uint32_t
+abi_serializer::compile_plan(type_plans& p, const type_name& type) const {
+    auto it = p.index.find(type);
+    if(it != p.index.end()) {
+        return it->second;
+    }
+
+    // registered before its elements and fields are compiled, so structs referring to themselves won't recurse forever
+    auto i = (uint32_t)p.plans.size();
+    p.plans.emplace_back();
+    p.index.emplace(type, i);
+
+    auto plan  = type_plan();
+    auto rtype = resolve_type(type);
+    auto ftype = fundamental_type(rtype);
+    plan.name  = rtype;
+
+    auto btype = built_in_types.find(ftype);
+    if(btype != built_in_types.end()) {
+        plan.kind        = type_plan::builtin_kind;
+        plan.unpack      = btype->second.first;
+        plan.pack        = btype->second.second;
+        plan.is_array    = is_array(rtype);
+        plan.is_optional = is_optional(rtype);
+    }
+    else if(is_array(rtype)) {
+        plan.kind    = type_plan::array_kind;
+        plan.element = compile_plan(p, ftype);
+    }
+    else if(is_optional(rtype)) {
+        plan.kind    = type_plan::optional_kind;
+        plan.element = compile_plan(p, ftype);
+    }
+    else {
+        auto chain    = get_struct_chain(rtype);
+        plan.kind     = type_plan::struct_kind;
+        plan.has_base = chain.size() > 1;
+        for(auto st : chain) {
+            for(const auto& field : st->fields) {
+                auto f = compile_plan(p, field.type);
+                plan.fields.emplace_back(field.name, f);
+            }
+        }
+    }
+
+    // `p.plans` may be reallocated by the recursive calls
+    p.plans[i] = std::move(plan);
+    return i;
+}
+
+template <typename Func>
+auto
+abi_serializer::with_plan(const type_name& type, Func&& func) const {
+    auto it = plans.index.find(type);
+    if(it != plans.index.end()) {
+        return func(plans, plans[it->second]);
+    }
+    auto p = type_plans();
+    auto i = compile_plan(p, type);
+    return func(p, p[i]);
+}
+
+const abi_serializer::type_plan*
+abi_serializer::find_plan(const type_name& type) const {
+    auto it = plans.index.find(type);
+    if(it != plans.index.end()) {
+        return &plans[it->second];
+    }
+    return nullptr;
 }
 
 bool
@@ -255,45 +531,42 @@ abi_serializer::resolve_type(const type_name& type) const {
     return type;
 }
 
-void
-abi_serializer::binary_to_variant(const type_name& type, fc::datastream<const char*>& stream,
-                                  fc::mutable_variant_object& obj) const {
-    const auto& st = get_struct(type);
-    if(st.base != type_name()) {
-        binary_to_variant(resolve_type(st.base), stream, obj);
-    }
-    for(const auto& field : st.fields) {
-        obj(field.name, binary_to_variant(resolve_type(field.type), stream));
-    }
-}
-
 fc::variant
-abi_serializer::binary_to_variant(const type_name& type, fc::datastream<const char*>& stream) const {
-    type_name rtype = resolve_type(type);
-    auto      ftype = fundamental_type(rtype);
-    auto      btype = built_in_types.find(ftype);
-    if(btype != built_in_types.end()) {
-        return btype->second.first(stream, is_array(rtype), is_optional(rtype));
+abi_serializer::binary_to_variant(const type_plans& p, const type_plan& plan, fc::datastream<const char*>& stream) const {
+    switch(plan.kind) {
+    case type_plan::builtin_kind: {
+        return plan.unpack(stream, plan.is_array, plan.is_optional);
     }
-    if(is_array(rtype)) {
+    case type_plan::array_kind: {
         fc::unsigned_int size;
         fc::raw::unpack(stream, size);
         vector<fc::variant> vars;
         vars.resize(size);
+        const auto& element = p[plan.element];
         for(auto& var : vars) {
-            var = binary_to_variant(ftype, stream);
+            var = binary_to_variant(p, element, stream);
         }
         return fc::variant(std::move(vars));
     }
-    else if(is_optional(rtype)) {
+    case type_plan::optional_kind: {
         char flag;
         fc::raw::unpack(stream, flag);
-        return flag ? binary_to_variant(ftype, stream) : fc::variant();
+        return flag ? binary_to_variant(p, p[plan.element], stream) : fc::variant();
     }
+    default: {
+        fc::mutable_variant_object mvo;
+        mvo.reserve(plan.fields.size());
+        for(const auto& field : plan.fields) {
+            mvo(field.first, binary_to_variant(p, p[field.second], stream));
+        }
+        return fc::variant(std::move(mvo));
+    }
+    }  // switch
+}
 
-    fc::mutable_variant_object mvo;
-    binary_to_variant(rtype, stream, mvo);
-    return fc::variant(std::move(mvo));
+fc::variant
+abi_serializer::binary_to_variant(const type_name& type, fc::datastream<const char*>& stream) const {
+    return with_plan(type, [&](const auto& p, const auto& plan) { return binary_to_variant(p, plan, stream); });
 }
 
 fc::variant
@@ -303,65 +576,68 @@ abi_serializer::binary_to_variant(const type_name& type, const bytes& binary) co
 }
 
 void
-abi_serializer::variant_to_binary(const type_name& type, const fc::variant& var, fc::datastream<char*>& ds) const {
+abi_serializer::variant_to_binary(const type_plans& p, const type_plan& plan, const fc::variant& var, fc::datastream<char*>& ds) const {
+    const auto& type = plan.name;
     try {
-        auto rtype = resolve_type(type);
-
-        auto btype = built_in_types.find(fundamental_type(rtype));
-        if(btype != built_in_types.end()) {
-            btype->second.second(var, ds, is_array(rtype), is_optional(rtype));
+        switch(plan.kind) {
+        case type_plan::builtin_kind: {
+            plan.pack(var, ds, plan.is_array, plan.is_optional);
+            break;
         }
-        else if(is_array(rtype)) {
-            vector<fc::variant> vars = var.get_array();
+        case type_plan::array_kind: {
+            const auto& vars = var.get_array();
             fc::raw::pack(ds, (fc::unsigned_int)vars.size());
+            const auto& element = p[plan.element];
             for(const auto& var : vars) {
-                variant_to_binary(fundamental_type(rtype), var, ds);
+                variant_to_binary(p, element, var, ds);
             }
+            break;
         }
-        else {
-            const auto& st = get_struct(rtype);
+        case type_plan::optional_kind: {
+            // same as fc::optional, flag followed by the value if there's one
+            fc::raw::pack(ds, (char)!var.is_null());
+            if(!var.is_null()) {
+                variant_to_binary(p, p[plan.element], var, ds);
+            }
+            break;
+        }
+        case type_plan::struct_kind: {
             if(var.is_object()) {
                 const auto& vo = var.get_object();
-
-                if(st.base != type_name()) {
-                    variant_to_binary(resolve_type(st.base), var, ds);
-                }
-                for(const auto& field : st.fields) {
-                    if(vo.contains(string(field.name).c_str())) {
-                        variant_to_binary(field.type, vo[field.name], ds);
+                for(const auto& field : plan.fields) {
+                    auto it = vo.find(field.first);
+                    if(it != vo.end()) {
+                        variant_to_binary(p, p[field.second], it->value(), ds);
                     }
                     else {
-                        variant_to_binary(field.type, fc::variant(), ds);
+                        variant_to_binary(p, p[field.second], fc::variant(), ds);
                         /// TODO: default construct field and write it out
-                        FC_THROW("Missing '${f}' in variant object", ("f", field.name));
+                        FC_THROW("Missing '${f}' in variant object", ("f", field.first));
                     }
                 }
             }
             else if(var.is_array()) {
                 const auto& va = var.get_array();
 
-                FC_ASSERT(st.base == type_name(), "support for base class as array not yet implemented");
-                /*if( st.base != type_name() ) {
-               variant_to_binary(resolve_type(st.base), var, ds);
-            }
-            */
-                uint32_t i = 0;
+                FC_ASSERT(!plan.has_base, "support for base class as array not yet implemented");
                 if(va.size() > 0) {
-                    for(const auto& field : st.fields) {
-                        idump((field.type)(va[i])(i));
-                        if(va.size() > i)
-                            variant_to_binary(field.type, va[i], ds);
-                        else
-                            variant_to_binary(field.type, fc::variant(), ds);
-                        ++i;
+                    for(auto i = 0u; i < plan.fields.size(); i++) {
+                        variant_to_binary(p, p[plan.fields[i].second], i < va.size() ? va[i] : fc::variant(), ds);
                     }
                 }
             }
+            break;
         }
+        }  // switch
     }
     FC_CAPTURE_AND_RETHROW((type)(var))
 }
 
+void
+abi_serializer::variant_to_binary(const type_name& type, const fc::variant& var, fc::datastream<char*>& ds) const {
+    with_plan(type, [&](const auto& p, const auto& plan) { variant_to_binary(p, plan, var, ds); });
+}
+
 bytes
 abi_serializer::variant_to_binary(const type_name& type, const fc::variant& var) const {
     try {
@@ -369,15 +645,151 @@ abi_serializer::variant_to_binary(const type_name& type, const fc::variant& var)
             return var.as<bytes>();
         }
 
-        bytes                 temp(1024 * 1024);
-        fc::datastream<char*> ds(temp.data(), temp.size());
-        variant_to_binary(type, var, ds);
-        temp.resize(ds.tellp());
-        return temp;
+        auto binary = bytes();
+        __internal::pack_to(binary, [&](auto& ds) { variant_to_binary(type, var, ds); });
+        return binary;
     }
     FC_CAPTURE_AND_RETHROW((type)(var))
 }
 
+vector<const struct_def*>
+abi_serializer::get_struct_chain(const type_name& type) const {
+    auto chain = vector<const struct_def*>{&get_struct(type)};
+    while(chain.back()->base != type_name()) {
+        chain.emplace_back(&get_struct(resolve_type(chain.back()->base)));
+    }
+    std::reverse(chain.begin(), chain.end());
+    return chain;
+}
+
+void
+abi_serializer::json_to_binary(const type_plans& p, const type_plan& plan, const impl::json_slice& json, bytes& binary) const {
+    const auto& type = plan.name;
+    try {
+        switch(plan.kind) {
+        case type_plan::builtin_kind: {
+            auto var = impl::json_to_variant(json);
+            __internal::pack_to(binary, [&](auto& ds) { plan.pack(var, ds, plan.is_array, plan.is_optional); });
+            break;
+        }
+        case type_plan::array_kind: {
+            auto elements = impl::json_parse_array(json);
+            __internal::pack_to(binary, [&](auto& ds) { fc::raw::pack(ds, (fc::unsigned_int)elements.size()); });
+            const auto& element = p[plan.element];
+            for(const auto& e : elements) {
+                json_to_binary(p, element, e, binary);
+            }
+            break;
+        }
+        case type_plan::optional_kind: {
+            auto is_null = (json.end - json.begin == 4 && memcmp(json.begin, "null", 4) == 0);
+            binary.push_back(!is_null);
+            if(!is_null) {
+                json_to_binary(p, p[plan.element], json, binary);
+            }
+            break;
+        }
+        case type_plan::struct_kind: {
+            if(!json.is_object()) {
+                // structs given as arrays are rare, leave them to the variant path
+                auto var = impl::json_to_variant(json);
+                __internal::pack_to(binary, [&](auto& ds) { variant_to_binary(p, plan, var, ds); });
+                break;
+            }
+            auto vo = impl::json_parse_object(json);
+            for(const auto& field : plan.fields) {
+                auto v = vo.find(field.first.c_str());
+                if(v == nullptr) {
+                    // keep the same error as variants, which fails on packing null first in most cases
+                    __internal::pack_to(binary, [&](auto& ds) { variant_to_binary(p, p[field.second], fc::variant(), ds); });
+                    FC_THROW("Missing '${f}' in variant object", ("f", field.first));
+                }
+                json_to_binary(p, p[field.second], *v, binary);
+            }
+            break;
+        }
+        }  // switch
+    }
+    FC_CAPTURE_AND_RETHROW((type)(json))
+}
+
+void
+abi_serializer::json_to_binary(const type_name& type, const impl::json_slice& json, bytes& binary) const {
+    with_plan(type, [&](const auto& p, const auto& plan) { json_to_binary(p, plan, json, binary); });
+}
+
+bytes
+abi_serializer::json_to_binary(const type_name& type, const string& json) const {
+    try {
+        auto slice = impl::json_parse(json);
+        if(!is_type(type)) {
+            return impl::json_to_variant(slice).as<bytes>();
+        }
+
+        auto binary = bytes();
+        json_to_binary(type, slice, binary);
+        return binary;
+    }
+    FC_CAPTURE_AND_RETHROW((type)(json))
+}
+
+void
+abi_serializer::binary_to_json(const type_plans& p, const type_plan& plan, fc::datastream<const char*>& binary, string& json) const {
+    switch(plan.kind) {
+    case type_plan::builtin_kind: {
+        json += fc::json::to_string(plan.unpack(binary, plan.is_array, plan.is_optional));
+        break;
+    }
+    case type_plan::array_kind: {
+        fc::unsigned_int size;
+        fc::raw::unpack(binary, size);
+        const auto& element = p[plan.element];
+        json += '[';
+        for(auto i = 0u; i < size.value; i++) {
+            if(i > 0) {
+                json += ',';
+            }
+            binary_to_json(p, element, binary, json);
+        }
+        json += ']';
+        break;
+    }
+    case type_plan::optional_kind: {
+        char flag;
+        fc::raw::unpack(binary, flag);
+        if(flag) {
+            binary_to_json(p, p[plan.element], binary, json);
+        }
+        else {
+            json += "null";
+        }
+        break;
+    }
+    case type_plan::struct_kind: {
+        json += '{';
+        for(const auto& field : plan.fields) {
+            impl::json_key(json, field.first.c_str());
+            binary_to_json(p, p[field.second], binary, json);
+        }
+        json += '}';
+        break;
+    }
+    }  // switch
+}
+
+void
+abi_serializer::binary_to_json(const type_name& type, fc::datastream<const char*>& binary, string& json) const {
+    with_plan(type, [&](const auto& p, const auto& plan) { binary_to_json(p, plan, binary, json); });
+}
+
+string
+abi_serializer::binary_to_json(const type_name& type, const bytes& binary) const {
+    auto ds   = fc::datastream<const char*>(binary.data(), binary.size());
+    auto json = string();
+    binary_to_json(type, ds, json);
+    return json;
+}
+
 type_name
 abi_serializer::get_action_type(name action) const {
     auto itr = actions.find(action);
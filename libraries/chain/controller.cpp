@@ -8,6 +8,8 @@
 #include <evt/chain/authority_checker.hpp>
 #include <evt/chain/block_log.hpp>
 #include <evt/chain/fork_database.hpp>
+#include <evt/chain/incremental_merkle.hpp>
+#include <evt/chain/thread_pool.hpp>
 #include <evt/chain/token_database.hpp>
 
 #include <evt/chain/block_summary_object.hpp>
@@ -19,6 +21,11 @@
 #include <fc/io/json.hpp>
 #include <fc/scoped_exit.hpp>
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
 #include <evt/chain/contracts/evt_contract.hpp>
 
 namespace evt { namespace chain {
@@ -29,15 +36,21 @@ struct pending_state {
         , _token_db_session(move(ts)) {}
     pending_state(pending_state&& ps)
         : _db_session(move(ps._db_session))
-        , _token_db_session(move(ps._token_db_session)) {}
+        , _token_db_session(move(ps._token_db_session))
+        , _authority_cache(move(ps._authority_cache)) {}
 
     database::session       _db_session;
     token_database::session _token_db_session;
+    authority_cache         _authority_cache;
 
     block_state_ptr _pending_block_state;
 
     vector<action_receipt> _actions;
 
+    // roots of actions and transactions are built as they are pushed
+    merkle_builder _action_merkle;
+    merkle_builder _trx_merkle;
+
     controller::block_status _block_status = controller::block_status::incomplete;
 
     void
@@ -60,6 +73,7 @@ struct controller_impl {
     chain_id_type           chain_id;
     bool                    replaying = false;
     abi_serializer          system_api;
+    thread_pool             workers;  ///< runs context-free work like signature recovery
 
     map<action_name, apply_handler> apply_handlers;
 
@@ -99,12 +113,13 @@ struct controller_impl {
         , reversible_blocks(cfg.blocks_dir/config::reversible_blocks_dir_name,
              cfg.read_only ? database::read_only : database::read_write,
              cfg.reversible_cache_size)
-        , blog(cfg.blocks_dir)
+        , blog(cfg.blocks_dir, cfg.blog_flush_interval_blocks, cfg.blog_flush_interval_ms, cfg.blocks_archive_dir)
         , fork_db(cfg.state_dir)
-        , token_db(cfg.tokendb_dir)
+        , token_db(cfg.tokendb_dir, cfg.tokendb_cache_size)
         , conf(cfg)
         , chain_id(cfg.genesis.compute_chain_id())
-        , system_api(contracts::evt_contract_abi()) {
+        , system_api(contracts::evt_contract_abi())
+        , workers(cfg.thread_pool_size) {
 #define SET_APP_HANDLER(action) \
     set_apply_handler(#action, &BOOST_PP_CAT(contracts::apply_evt, BOOST_PP_CAT(_, action)))
 
@@ -166,6 +181,9 @@ struct controller_impl {
         emit(self.irreversible_block, s);
         db.commit(s->block_num);
         token_db.pop_savepoints(s->block_num);
+        // changes of the block which became irreversible are written in one batch,
+        // the batch is always empty when transactions are applied
+        token_db.flush();
 
         if(s->block_num <= lh_block_num) {
             return;
@@ -174,15 +192,133 @@ struct controller_impl {
         FC_ASSERT(s->block_num - 1 == lh_block_num, "unlinkable block", ("s->block_num",s->block_num)("lh_block_num", lh_block_num));
         FC_ASSERT(s->block->previous == log_head->id(), "irreversible doesn't link to block log head");
         blog.append(s->block);
+        prune_reversible_blocks();
+    }
+
+    // irreversible blocks still buffered by block log are kept, they're replayed from here after a crash
+    void
+    prune_reversible_blocks() {
+        auto flushed_num = blog.flushed_block_num();
 
         const auto& ubi = reversible_blocks.get_index<reversible_block_index,by_num>();
         auto objitr = ubi.begin();
-        while(objitr != ubi.end() && objitr->blocknum <= s->block_num) {
+        while(objitr != ubi.end() && objitr->blocknum <= flushed_num) {
             reversible_blocks.remove( *objitr );
             objitr = ubi.begin();
         }
     }
 
+    void
+    replay_irreversible_block(const signed_block_ptr& b) {
+        auto bsp = apply_block(b, controller::block_status::irreversible);
+        EVT_ASSERT(bsp->id == b->id(), block_validate_exception,
+                   "Replayed block doesn't match the one in block log, try to replay with --force-all-checks",
+                   ("expected", b->id())("actual", bsp->id));
+
+        bsp->validated        = true;
+        bsp->in_current_chain = true;
+        head                  = bsp;
+
+        // all the blocks in block log are irreversible
+        on_irreversible(bsp);
+    }
+
+    /**
+     *  Replay the irreversible blocks in block log without fork database.
+     *  Blocks are read and decoded by a separate thread, and the state of last block is set into fork database at the end.
+     */
+    void
+    replay_block_log(uint32_t end_num) {
+        const size_t max_queued_blocks = 1024;
+
+        std::mutex                   mutex;
+        std::condition_variable      cv;
+        std::deque<signed_block_ptr> queue;
+        bool                         done = false;  // no more blocks from reader
+        bool                         stop = false;  // tell reader to quit
+        std::exception_ptr           error;
+
+        auto start_num = head->block_num + 1;
+        auto reader    = std::thread([&, start_num] {
+            try {
+                auto pos = blog.get_block_pos(start_num);
+                for(auto num = start_num; num <= end_num; num++) {
+                    auto b = signed_block_ptr();
+                    if(pos == block_log::npos) {
+                        // blocks moved into archive can only be read by number
+                        pos = blog.get_block_pos(num);
+                    }
+                    if(pos != block_log::npos) {
+                        auto r = blog.read_block(pos);
+                        b      = std::move(r.first);
+                        pos    = r.second;
+                    }
+                    else if(!(b = blog.read_block_by_num(num))) {
+                        break;
+                    }
+                    FC_ASSERT(b->block_num() == num, "Wrong block was read from block log.",
+                              ("returned", b->block_num())("expected", num));
+
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait(lock, [&] { return queue.size() < max_queued_blocks || stop; });
+                    if(stop) {
+                        break;
+                    }
+                    queue.emplace_back(std::move(b));
+                    cv.notify_all();
+                }
+            }
+            catch(...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+            cv.notify_all();
+        });
+        auto join_reader = fc::make_scoped_exit([&]() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            cv.notify_all();
+            reader.join();
+        });
+
+        auto last_time = fc::time_point::now();
+        auto last_num  = head->block_num;
+        while(true) {
+            auto b = signed_block_ptr();
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] { return !queue.empty() || done; });
+                if(queue.empty()) {
+                    break;
+                }
+                b = std::move(queue.front());
+                queue.pop_front();
+                cv.notify_all();
+            }
+            replay_irreversible_block(b);
+
+            auto now = fc::time_point::now();
+            if(now - last_time >= fc::seconds(5)) {
+                std::cerr << std::setw(10) << head->block_num << " of " << end_num << ", "
+                          << (head->block_num - last_num) * 1000000 / (now - last_time).count() << " blocks/s\r";
+                last_time = now;
+                last_num  = head->block_num;
+            }
+        }
+        join_reader.cancel();
+        reader.join();
+        if(error) {
+            std::rethrow_exception(error);
+        }
+
+        // fork database only keeps the state of head block
+        fork_db.reset(head);
+    }
+
     void
     init() {
         /**
@@ -200,10 +336,15 @@ struct controller_impl {
                 ilog( "existing block log, attempting to replay ${n} blocks", ("n",end->block_num()) );
 
                 auto start = fc::time_point::now();
-                while(auto next = blog.read_block_by_num(head->block_num + 1)) {
-                    self.push_block(next, controller::block_status::irreversible);
-                    if(next->block_num() % 100 == 0) {
-                        std::cerr << std::setw(10) << next->block_num() << " of " << end->block_num() <<"\r";
+                if(!conf.force_all_checks) {
+                    replay_block_log(end->block_num());
+                }
+                else {
+                    while(auto next = blog.read_block_by_num(head->block_num + 1)) {
+                        self.push_block(next, controller::block_status::irreversible);
+                        if(next->block_num() % 100 == 0) {
+                            std::cerr << std::setw(10) << next->block_num() << " of " << end->block_num() <<"\r";
+                        }
                     }
                 }
 
@@ -216,9 +357,10 @@ struct controller_impl {
                 std::cerr<< "\n";
                 ilog("${n} reversible blocks replayed", ("n",rev));
                 auto end = fc::time_point::now();
-                ilog("replayed ${n} blocks in seconds, ${mspb} ms/block",
+                ilog("replayed ${n} blocks in ${duration} seconds, ${mspb} ms/block, ${bps} blocks/s",
                     ("n", head->block_num)("duration", (end-start).count()/1000000)
-                    ("mspb", ((end-start).count()/1000.0)/head->block_num));
+                    ("mspb", ((end-start).count()/1000.0)/head->block_num)
+                    ("bps", head->block_num * 1000000.0 / std::max<int64_t>((end-start).count(), 1)));
                 std::cerr<< "\n";
                 replaying = false;
             }
@@ -354,7 +496,7 @@ struct controller_impl {
         }
     }
 
-    void
+    block_state_ptr
     commit_block(bool add_to_fork_db) {
         if(add_to_fork_db) {
             pending->_pending_block_state->validated = true;
@@ -374,8 +516,10 @@ struct controller_impl {
             });
         }
 
+        auto bsp = pending->_pending_block_state;
         pending->push();
         pending.reset();
+        return bsp;
     }
 
     // The returned scoped_exit should not exceed the lifetime of the pending which existed when make_block_restore_point was called.
@@ -384,14 +528,20 @@ struct controller_impl {
         auto orig_block_transactions_size = pending->_pending_block_state->block->transactions.size();
         auto orig_state_transactions_size = pending->_pending_block_state->trxs.size();
         auto orig_state_actions_size      = pending->_actions.size();
+        auto orig_action_merkle           = pending->_action_merkle;
+        auto orig_trx_merkle              = pending->_trx_merkle;
 
         std::function<void()> callback = [this,
                                           orig_block_transactions_size,
                                           orig_state_transactions_size,
-                                          orig_state_actions_size]() {
+                                          orig_state_actions_size,
+                                          orig_action_merkle,
+                                          orig_trx_merkle]() {
             pending->_pending_block_state->block->transactions.resize(orig_block_transactions_size);
             pending->_pending_block_state->trxs.resize(orig_state_transactions_size);
             pending->_actions.resize(orig_state_actions_size);
+            pending->_action_merkle = orig_action_merkle;
+            pending->_trx_merkle    = orig_trx_merkle;
         };
 
         return fc::make_scoped_exit(std::move(callback));
@@ -406,6 +556,7 @@ struct controller_impl {
         pending->_pending_block_state->block->transactions.emplace_back(trx);
         transaction_receipt& r = pending->_pending_block_state->block->transactions.back();
         r.status               = status;
+        pending->_trx_merkle.append(r.digest());
         return r;
     }
 
@@ -443,7 +594,7 @@ struct controller_impl {
                     const static uint32_t max_authority_depth = conf.genesis.initial_configuration.max_authority_depth;
                     // NOTICE: Expose keys when authorized failed is temporarily, for better debuging
                     const auto& keys = trx->recover_keys(chain_id);
-                    auto checker = authority_checker(keys, token_db, max_authority_depth);
+                    auto checker = authority_checker(keys, token_db, max_authority_depth, &pending->_authority_cache);
                     for(const auto& act : trx->trx.actions) {
                         EVT_ASSERT(checker.satisfied(act), unsatisfied_authorization,
                                    "${name} action in domain: ${domain} with key: ${key} authorized failed, provided keys: ${keys}",
@@ -451,6 +602,11 @@ struct controller_impl {
                     }
                 }
 
+                // changes made by the actions stay in token database even if the transaction fails later
+                auto invalidate_auth = fc::make_scoped_exit([&]() {
+                    pending->_authority_cache.invalidate(trx->trx.actions);
+                });
+
                 trx_context.exec();
                 trx_context.finalize();  // Automatically rounds up network and CPU usage in trace and bills payers if successful
 
@@ -466,6 +622,9 @@ struct controller_impl {
                     trace->receipt = r;
                 }
 
+                for(const auto& a : trx_context.executed) {
+                    pending->_action_merkle.append(a.digest());
+                }
                 fc::move_append(pending->_actions, move(trx_context.executed));
 
                 // call the accept signal but only once for this transaction
@@ -550,18 +709,72 @@ struct controller_impl {
         static_cast<signed_block_header&>(*p->block) = p->header;
     }  /// sign_block
 
+    /**
+     *  Load the objects which the actions will touch into token database cache, it's run in thread pool.
+     *  Every evt action declares its footprint by `domain` and `key`, so no action data needs to be unpacked.
+     */
     void
+    prefetch_token_db(const transaction& trx) const {
+        for(const auto& act : trx.actions) {
+            if(act.domain == N128(domain)) {
+                token_db.prefetch_domain(act.key);
+            }
+            else if(act.domain == N128(group)) {
+                token_db.prefetch_group(act.key);
+            }
+            else if(act.domain == N128(account)) {
+                token_db.prefetch_account(act.key);
+            }
+            else if(act.domain == N128(delay)) {
+                token_db.prefetch_delay(act.key);
+            }
+            else {
+                // permission of token actions is in domain
+                token_db.prefetch_domain(act.domain);
+                token_db.prefetch_token(act.domain, act.key);
+            }
+        }
+    }
+
+    block_state_ptr
     apply_block(const signed_block_ptr& b, controller::block_status s) {
         try {
             try {
                 FC_ASSERT(b->block_extensions.size() == 0, "no supported extensions");
-                start_block(b->timestamp, b->confirmed, s);
 
+                // token database is only read by prefetching, which must be done before the block is committed
+                auto prefetches      = vector<std::future<void>>();
+                auto wait_prefetches = fc::make_scoped_exit([&]() {
+                    for(auto& f : prefetches) {
+                        f.wait();
+                    }
+                });
+
+                // keys of all the transactions are recovered in parallel while they're applied one by one,
+                // objects they touch are loaded into token database cache meanwhile.
+                auto mtrxs = vector<transaction_metadata_ptr>();
+                mtrxs.reserve(b->transactions.size());
+                prefetches.reserve(b->transactions.size());
                 for(const auto& receipt : b->transactions) {
-                    auto& pt   = receipt.trx;
-                    auto  mtrx = std::make_shared<transaction_metadata>(pt);
+                    auto mtrx = std::make_shared<transaction_metadata>(receipt.trx);
+                    if(!self.skip_auth_check()) {
+                        transaction_metadata::start_recover_keys(mtrx, workers, chain_id);
+                    }
+                    if(workers.size() > 0) {
+                        prefetches.emplace_back(workers.post([this, mtrx] { prefetch_token_db(mtrx->trx); }));
+                    }
+                    mtrxs.emplace_back(std::move(mtrx));
+                }
+
+                start_block(b->timestamp, b->confirmed, s);
+
+                for(const auto& mtrx : mtrxs) {
                     push_transaction(mtrx, fc::time_point::maximum(), false);
                 }
+                wait_prefetches.cancel();
+                for(auto& f : prefetches) {
+                    f.wait();
+                }
 
                 finalize_block();
                 sign_block([&](const auto&) { return b->producer_signature; }, false); // trust
@@ -570,8 +783,7 @@ struct controller_impl {
                 //FC_ASSERT( b->id() == pending->_pending_block_state->block->id(),
                 //           "applying block didn't produce expected block id" );
 
-                commit_block(false);
-                return;
+                return commit_block(false);
             }
             catch(const fc::exception& e) {
                 edump((e.to_detail_string()));
@@ -690,23 +902,14 @@ struct controller_impl {
 
     void
     set_action_merkle() {
-        vector<digest_type> action_digests;
-        action_digests.reserve(pending->_actions.size());
-        for(const auto& a : pending->_actions)
-            action_digests.emplace_back(a.digest());
-
-        pending->_pending_block_state->header.action_mroot = merkle(move(action_digests));
+        FC_ASSERT(pending->_action_merkle.size() == pending->_actions.size());
+        pending->_pending_block_state->header.action_mroot = pending->_action_merkle.get_root();
     }
 
     void
     set_trx_merkle() {
-        vector<digest_type> trx_digests;
-        const auto&         trxs = pending->_pending_block_state->block->transactions;
-        trx_digests.reserve(trxs.size());
-        for(const auto& a : trxs)
-            trx_digests.emplace_back(a.digest());
-
-        pending->_pending_block_state->header.transaction_mroot = merkle(move(trx_digests));
+        FC_ASSERT(pending->_trx_merkle.size() == pending->_pending_block_state->block->transactions.size());
+        pending->_pending_block_state->header.transaction_mroot = pending->_trx_merkle.get_root();
     }
 
     void
@@ -920,6 +1123,14 @@ controller::fetch_block_by_number(uint32_t block_num) const {
     FC_CAPTURE_AND_RETHROW((block_num))
 }
 
+signed_block_ptr
+controller::fetch_irreversible_block_by_number(uint32_t block_num) const {
+    try {
+        return my->blog.read_block_by_num(block_num);
+    }
+    FC_CAPTURE_AND_RETHROW((block_num))
+}
+
 block_state_ptr controller::fetch_block_state_by_id(block_id_type id) const {
     auto state = my->fork_db.get_block(id);
     return state;
@@ -1041,6 +1252,17 @@ controller::get_chain_id() const {
     return my->chain_id;
 }
 
+thread_pool&
+controller::get_thread_pool() {
+    return my->workers;
+}
+
+void
+controller::flush_block_log() {
+    my->blog.flush_if_stale();
+    my->prune_reversible_blocks();
+}
+
 const apply_handler*
 controller::find_apply_handler(action_name act) const {
     auto handler = my->apply_handlers.find(act);
@@ -46,6 +46,7 @@ struct fork_database_impl {
     fork_multi_index_type index;
     block_state_ptr       head;
     fc::path              datadir;
+    block_id_type         irreversible_root;  // set by reset, already announced as irreversible
 };
 
 fork_database::fork_database(const fc::path& data_dir)
@@ -128,6 +129,15 @@ fork_database::set(block_state_ptr s) {
     }
 }
 
+void
+fork_database::reset(block_state_ptr s) {
+    FC_ASSERT(s->id == s->header.id());
+    my->index.clear();
+    my->index.insert(s);
+    my->head              = s;
+    my->irreversible_root = s->id;
+}
+
 block_state_ptr
 fork_database::add(block_state_ptr n) {
     auto inserted = my->index.insert(n);
@@ -264,7 +274,9 @@ fork_database::prune(const block_state_ptr& h) {
 
     auto itr = my->index.find(h->id);
     if(itr != my->index.end()) {
-        irreversible(*itr);
+        if((*itr)->id != my->irreversible_root) {
+            irreversible(*itr);
+        }
         my->index.erase(itr);
     }
 
@@ -4,6 +4,7 @@
  */
 #pragma once
 #include <functional>
+#include <unordered_map>
 
 #include <evt/chain/config.hpp>
 #include <evt/chain/contracts/types.hpp>
@@ -14,12 +15,81 @@
 #include <fc/scoped_exit.hpp>
 
 #include <boost/algorithm/cxx11/all_of.hpp>
-#include <boost/range/algorithm/find.hpp>
 
 namespace evt { namespace chain {
 
 using namespace evt::chain::contracts;
 
+/**
+ * Decoded permissions and groups used by authority_checker, it lives as long as the pending block,
+ * so a batch of actions in the same domain only reads the domain once.
+ * Entries must be invalidated once `updatedomain` or `updategroup` is applied.
+ */
+class authority_cache {
+private:
+    struct domain_permissions {
+        permission_def issue;
+        permission_def transfer;
+        permission_def manage;
+    };
+
+public:
+    void
+    read_permission(const token_database& token_db, const domain_name& domain, const action_name name,
+                    const std::function<void(const permission_def&)>& cb) {
+        auto it = _domains.find(domain);
+        if(it == _domains.end()) {
+            token_db.read_domain(domain, [&](const auto& d) {
+                it = _domains.emplace(domain, domain_permissions{d.issue, d.transfer, d.manage}).first;
+            });
+        }
+        auto& perms = it->second;
+        if(name == N(issuetoken)) {
+            cb(perms.issue);
+        }
+        else if(name == N(transfer)) {
+            cb(perms.transfer);
+        }
+        else if(name == N(updatedomain)) {
+            cb(perms.manage);
+        }
+    }
+
+    void
+    read_group(const token_database& token_db, const group_name& name, const std::function<void(const group_def&)>& cb) {
+        auto it = _groups.find(name);
+        if(it == _groups.end()) {
+            token_db.read_group(name, [&](const auto& g) {
+                it = _groups.emplace(name, g).first;
+            });
+        }
+        cb(it->second);
+    }
+
+    // drop the entries which may be changed by the actions
+    void
+    invalidate(const vector<action>& actions) {
+        for(const auto& act : actions) {
+            if(act.domain == N128(domain) && act.name == N(updatedomain)) {
+                _domains.erase(act.key);
+            }
+            else if(act.domain == N128(group) && act.name == N(updategroup)) {
+                _groups.erase(act.key);
+            }
+        }
+    }
+
+    void
+    clear() {
+        _domains.clear();
+        _groups.clear();
+    }
+
+private:
+    std::unordered_map<domain_name, domain_permissions, name128_hash> _domains;
+    std::unordered_map<group_name, group_def, name128_hash>           _groups;
+};
+
 /**
 * @brief This class determines whether a set of signing keys are sufficient to satisfy an authority or not
 *
@@ -32,6 +102,7 @@ class authority_checker {
 private:
     const flat_set<public_key_type>& _signing_keys;
     const token_database&            _token_db;
+    authority_cache*                 _cache;
     const uint32_t                   _max_recursion_depth;
     vector<bool>                     _used_keys;
 
@@ -51,7 +122,8 @@ private:
 
         uint32_t
         operator()(const public_key_type& key, const weight_type weight) {
-            auto itr = boost::find(checker._signing_keys, key);
+            // signing keys are sorted, binary search instead of comparing with all of them
+            auto itr = checker._signing_keys.find(key);
             if(itr != checker._signing_keys.end()) {
                 checker._used_keys[itr - checker._signing_keys.begin()] = true;
                 total_weight += weight;
@@ -61,15 +133,21 @@ private:
     };
 
 public:
-    authority_checker(const flat_set<public_key_type>& signing_keys, const token_database& token_db, uint32_t max_recursion_depth)
+    authority_checker(const flat_set<public_key_type>& signing_keys, const token_database& token_db, uint32_t max_recursion_depth,
+                      authority_cache* cache = nullptr)
         : _signing_keys(signing_keys)
         , _token_db(token_db)
+        , _cache(cache)
         , _max_recursion_depth(max_recursion_depth)
         , _used_keys(signing_keys.size(), false) {}
 
 private:
     void
     get_permission(const domain_name& domain, const action_name name, std::function<void(const permission_def&)>&& cb) {
+        if(_cache != nullptr) {
+            _cache->read_permission(_token_db, domain, name, cb);
+            return;
+        }
         _token_db.read_domain(domain, [&](const auto& domain) {
             if(name == N(issuetoken)) {
                 cb(domain.issue);
@@ -85,6 +163,10 @@ private:
 
     void
     get_group(const group_name& name, std::function<void(const group_def&)>&& cb) {
+        if(_cache != nullptr) {
+            _cache->read_group(_token_db, name, cb);
+            return;
+        }
         _token_db.read_group(name, cb);
     }
 
@@ -195,6 +277,16 @@ private:
     satisfied_node(const group& group, const group::node& node, uint32_t depth) {
         FC_ASSERT(depth < _max_recursion_depth);
         FC_ASSERT(!node.is_leaf());
+
+        // weight of child nodes not visited yet, child nodes are stored continuously
+        uint32_t remaining = 0;
+        for(auto i = 0u; i < node.size; i++) {
+            remaining += group.nodes_[node.index + i].weight;
+        }
+        if(remaining < node.threshold) {
+            return false;
+        }
+
         auto vistor = weight_tally_visitor(*this);
         group.visit_node(node, [&](const auto& n) {
             FC_ASSERT(!n.is_root());
@@ -209,6 +301,10 @@ private:
             if(vistor.total_weight >= node.threshold) {
                 return false;  // no need to visit more nodes
             }
+            remaining -= n.weight;
+            if(vistor.total_weight + remaining < node.threshold) {
+                return false;  // threshold cannot be reached anymore
+            }
             return true;
         });
         if(vistor.total_weight >= node.threshold) {
@@ -31,21 +31,37 @@ class block_log_impl;
  * in the last 8 bytes the file. The block log can be read backwards by jumping back 8 bytes, following
  * the position, reading the block, jumping back 8 bytes, etc.
  *
- * Blocks can be accessed at random via block number through the index file. Seek to 8 * (block_num - 1)
+ * Blocks can be accessed at random via block number through the index file. Seek to 8 * (block_num - first_block_num)
  * to find the position of the block in the main file.
  *
+ * The header of the main file is the version, the number of the first block in the file (since version 2) and the
+ * genesis state. Logs start from block 1 unless the old blocks have been moved into the archive by `archive_log`,
+ * see block_log_archive. Reading the blocks in the archive by number is transparent when the archive is provided.
+ *
  * The main file is the only file that needs to persist. The index file can be reconstructed during a
  * linear scan of the main file.
+ *
+ * Reads are served from a read-only memory mapping of the flushed part of both files, so the read
+ * functions can be called from any thread, concurrently with appends made by the controller.
+ *
+ * Appended blocks are buffered and flushed together once `flush_interval_blocks` blocks are pending or
+ * `flush_interval_ms` has passed since the last flush, which is checked on each append. The owner should also
+ * call `flush_if_stale` periodically so the tail isn't left unflushed when appends stop. Blocks after
+ * `flushed_block_num` would be lost by a crash, so their other copies must be kept until they're flushed.
+ * Files are synced to disk when the log is closed. An incomplete block left at the end by a crash is
+ * truncated on open.
  */
 
 class block_log {
 public:
-    block_log(const fc::path& data_dir);
+    block_log(const fc::path& data_dir, uint32_t flush_interval_blocks = 1, uint32_t flush_interval_ms = 0,
+              const fc::path& archive_dir = fc::path());
     block_log(block_log&& other);
     ~block_log();
 
     uint64_t append(const signed_block_ptr& b);
     void     flush();
+    void     flush_if_stale();  // flushes if `flush_interval_ms` has passed since the last flush
     uint64_t reset_to_genesis(const genesis_state& gs, const signed_block_ptr& genesis_block);
 
     std::pair<signed_block_ptr, uint64_t> read_block(uint64_t file_pos) const;
@@ -57,18 +73,28 @@ public:
     }
 
     /**
-     * Return offset of block in file, or block_log::npos if it does not exist.
+     * Return offset of block in file, or block_log::npos if it does not exist or is not flushed yet.
      */
     uint64_t                get_block_pos(uint32_t block_num) const;
     signed_block_ptr        read_head() const;
     const signed_block_ptr& head() const;
 
+    // number of the last block written out of the buffer, 0 if there's none
+    uint32_t flushed_block_num() const;
+
     static const uint64_t npos = std::numeric_limits<uint64_t>::max();
 
+    static const uint32_t min_supported_version;
     static const uint32_t supported_version;
 
     static fc::path repair_log(const fc::path& data_dir, uint32_t truncate_at_block = 0);
 
+    /**
+     * Moves the old blocks into compressed segments of `blocks_per_segment` blocks in `archive_dir`,
+     * returns the number of first block which stays in the log.
+     */
+    static uint32_t archive_log(const fc::path& data_dir, const fc::path& archive_dir, uint32_t blocks_per_segment);
+
     static genesis_state extract_genesis_state(const fc::path& data_dir);
 
 private:
@@ -0,0 +1,67 @@
+/**
+ *  @file
+ *  @copyright defined in evt/LICENSE.txt
+ */
+#pragma once
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <boost/noncopyable.hpp>
+#include <fc/filesystem.hpp>
+#include <evt/chain/block.hpp>
+
+namespace evt { namespace chain {
+
+namespace detail {
+class block_log_segment;
+}
+
+/**
+ * Archive of the old irreversible blocks moved out of the block log.
+ *
+ * Each segment file holds a fixed range of blocks. Blocks are grouped into frames, and each frame is
+ * compressed independently with zstd. The footer records the offset of every frame and of every block
+ * inside its decompressed frame, so reading one block only decompresses the frame holding it.
+ *
+ * +---------+---------+-----+---------+--------+---------------+
+ * | Frame 1 | Frame 2 | ... | Frame N | Footer | Pos of Footer |
+ * +---------+---------+-----+---------+--------+---------------+
+ *
+ * Segments are independent from each other and from the block log. They can be deleted to prune the
+ * history, or moved to another directory which is used as the archive directory.
+ */
+class block_log_archive : boost::noncopyable {
+public:
+    block_log_archive(const fc::path& archive_dir);
+    ~block_log_archive();
+
+public:
+    // safe to be called from any thread, returns null if the block is not in any segment
+    signed_block_ptr read_block_by_num(uint32_t block_num) const;
+
+    const fc::path&
+    get_archive_dir() const { return archive_dir_; }
+
+public:
+    /**
+     * Writes `block_count` blocks starting from `first_block_num` into a new segment.
+     * `read_block` returns the packed data of each block, blocks are compressed `blocks_per_frame` at a time.
+     * Segment is written into a temporary file first and renamed when it's complete.
+     */
+    static fc::path write_segment(const fc::path& archive_dir, uint32_t first_block_num, uint32_t block_count,
+                                  uint32_t blocks_per_frame, int compression_level,
+                                  const std::function<std::pair<const char*, size_t>(uint32_t)>& read_block);
+
+private:
+    std::shared_ptr<detail::block_log_segment> get_segment(uint32_t block_num) const;
+
+private:
+    fc::path archive_dir_;
+
+    mutable std::mutex                                                     mutex_;
+    mutable std::map<uint32_t, std::pair<uint32_t, fc::path>>              segment_files_;  // first block num -> (last block num, file)
+    mutable std::map<uint32_t, std::shared_ptr<detail::block_log_segment>> segments_;       // opened segments
+};
+
+}}  // namespace evt::chain
@@ -16,7 +16,17 @@ typedef __uint128_t uint128_t;
 const static auto default_blocks_dir_name       = "blocks";
 const static auto reversible_blocks_dir_name    = "reversible";
 const static auto default_tokendb_dir_name      = "tokendb";
+const static auto default_tokendb_cache_size    = 64*1024;  /// max number of cached objects for each type
+const static auto default_tokendb_block_cache_size = 128*1024*1024;  /// shared block cache of all the column families
 const static auto default_reversible_cache_size = 340*1024*1024ll;/// 1MB * 340 blocks based on 21 producer BFT delay
+const static auto default_controller_thread_pool_size = 2;
+const static auto default_block_log_flush_interval_blocks = 32;
+const static auto default_block_log_flush_interval_ms     = 1000;
+
+const static auto default_blocks_archive_dir_name      = "blocks-archive";
+const static auto default_blocks_archive_segment_size  = 100000;  /// number of blocks in each segment of archive
+const static auto blocks_archive_frame_size            = 256;     /// number of blocks compressed together in segment
+const static auto blocks_archive_compression_level     = 9;
 
 const static auto default_state_dir_name        = "state";
 const static auto forkdb_filename               = "forkdb.dat";
@@ -3,14 +3,20 @@
  *  @copyright defined in evt/LICENSE.txt
  */
 #pragma once
+#include <unordered_map>
 #include <evt/chain/contracts/types.hpp>
 #include <evt/chain/exceptions.hpp>
 #include <evt/chain/trace.hpp>
 
+#include <fc/io/json.hpp>
 #include <fc/variant_object.hpp>
 
 namespace evt { namespace chain { namespace contracts {
 
+namespace impl {
+struct json_slice;
+}  // namespace impl
+
 using std::function;
 using std::map;
 using std::pair;
@@ -22,7 +28,10 @@ using namespace fc;
  *  be converted to and from JSON.
  */
 struct abi_serializer {
-    abi_serializer() { configure_built_in_types(); }
+    abi_serializer() {
+        configure_built_in_types();
+        compile_plans();
+    }
     abi_serializer(const abi_def& abi);
     void set_abi(const abi_def& abi);
 
@@ -30,14 +39,49 @@ struct abi_serializer {
     map<type_name, struct_def> structs;
     map<name, type_name>       actions;
 
-    typedef std::function<fc::variant(fc::datastream<const char*>&, bool, bool)>        unpack_function;
-    typedef std::function<void(const fc::variant&, fc::datastream<char*>&, bool, bool)> pack_function;
+    typedef fc::variant (*unpack_function)(fc::datastream<const char*>&, bool, bool);
+    typedef void (*pack_function)(const fc::variant&, fc::datastream<char*>&, bool, bool);
 
     map<type_name, pair<unpack_function, pack_function>> built_in_types;
     void                                                 configure_built_in_types();
 
     void validate() const;
 
+    /**
+     * Serialization plan of one type, types are resolved and the fields of bases are flattened
+     * when it's compiled. Elements and fields refer to other plans by their index in `type_plans`,
+     * so the plans stay valid when the serializer is copied.
+     */
+    struct type_plan {
+        enum kind_type { builtin_kind = 0, array_kind, optional_kind, struct_kind };
+
+        kind_type       kind        = builtin_kind;
+        type_name       name;  // resolved name
+        unpack_function unpack      = nullptr;
+        pack_function   pack        = nullptr;
+        bool            is_array    = false;  // flags passed to `unpack` and `pack`
+        bool            is_optional = false;
+        uint32_t        element     = 0;      // for arrays and optionals
+        bool            has_base    = false;
+
+        vector<pair<field_name, uint32_t>> fields;  // fields of bases come first
+    };
+
+    /**
+     * Plans of all the types used by ABI, they're compiled by `set_abi` and never changed afterwards,
+     * so one serializer can be used by multiple threads without locks
+     */
+    struct type_plans {
+        vector<type_plan>                       plans;
+        std::unordered_map<type_name, uint32_t> index;  // by names before resolved
+
+        const type_plan& operator[](uint32_t i) const { return plans[i]; }
+    };
+    type_plans plans;
+
+    // nullptr if `type` is not used by ABI
+    const type_plan* find_plan(const type_name& type) const;
+
     type_name resolve_type(const type_name& t) const;
     bool      is_array(const type_name& type) const;
     bool      is_optional(const type_name& type) const;
@@ -58,12 +102,26 @@ struct abi_serializer {
     fc::variant binary_to_variant(const type_name& type, fc::datastream<const char*>& binary) const;
     void        variant_to_binary(const type_name& type, const fc::variant& var, fc::datastream<char*>& ds) const;
 
+    // JSON text is converted by walking the struct definitions directly, only leaves of built-in types go through variants
+    bytes  json_to_binary(const type_name& type, const string& json) const;
+    string binary_to_json(const type_name& type, const bytes& binary) const;
+
+    void json_to_binary(const type_name& type, const impl::json_slice& json, bytes& binary) const;
+    void binary_to_json(const type_name& type, fc::datastream<const char*>& binary, string& json) const;
+
     template <typename T, typename Resolver>
     static void to_variant(const T& o, fc::variant& vo, Resolver resolver);
 
     template <typename T, typename Resolver>
     static void from_variant(const fc::variant& v, T& o, Resolver resolver);
 
+    // same as `to_variant` and `from_variant` but with JSON text, results are identical to converting the variants
+    template <typename T, typename Resolver>
+    static void to_json(const T& o, string& json, Resolver resolver);
+
+    template <typename T, typename Resolver>
+    static void from_json(const string& json, T& o, Resolver resolver);
+
     template <typename Vec>
     static bool
     is_empty_abi(const Vec& abi_vec) {
@@ -82,7 +140,20 @@ struct abi_serializer {
     }
 
 private:
-    void binary_to_variant(const type_name& type, fc::datastream<const char*>& stream, fc::mutable_variant_object& obj) const;
+    void     compile_plans();
+    uint32_t compile_plan(type_plans& p, const type_name& type) const;
+
+    // calls `func` with the plan of `type`, types which are not used by ABI are compiled for each call
+    template <typename Func>
+    auto with_plan(const type_name& type, Func&& func) const;
+
+    fc::variant binary_to_variant(const type_plans& p, const type_plan& plan, fc::datastream<const char*>& stream) const;
+    void        variant_to_binary(const type_plans& p, const type_plan& plan, const fc::variant& var, fc::datastream<char*>& ds) const;
+    void        json_to_binary(const type_plans& p, const type_plan& plan, const impl::json_slice& json, bytes& binary) const;
+    void        binary_to_json(const type_plans& p, const type_plan& plan, fc::datastream<const char*>& binary, string& json) const;
+
+    // struct and its bases, the root base comes first
+    vector<const struct_def*> get_struct_chain(const type_name& type) const;
 };
 
 namespace impl {
@@ -142,6 +213,50 @@ using not_require_abi_t = std::enable_if_t<!type_requires_abi_v<T>(), int>;
 template <typename T>
 using require_abi_t = std::enable_if_t<type_requires_abi_v<T>(), int>;
 
+/**
+ * Raw text of one JSON value, it points into the buffer being parsed
+ */
+struct json_slice {
+    const char* begin = nullptr;
+    const char* end   = nullptr;
+
+    bool is_object() const { return begin != end && *begin == '{'; }
+    bool is_array() const { return begin != end && *begin == '['; }
+    bool is_string() const { return begin != end && *begin == '"'; }
+};
+
+/**
+ * Members of a JSON object in the order of text, values are only parsed when they're used
+ */
+struct json_object {
+    vector<pair<json_slice, json_slice>> members;
+
+    // the first one wins for duplicated keys, same as the variant objects parsed by fc::json
+    const json_slice* find(const char* key) const;
+};
+
+json_slice         json_parse(const string& json);
+json_object        json_parse_object(const json_slice& json);
+vector<json_slice> json_parse_array(const json_slice& json);
+
+// leaves are converted by fc::json, plain strings are copied directly
+fc::variant json_to_variant(const json_slice& json);
+void        to_variant(const json_slice& json, fc::variant& v);
+
+// appends `"name":` to the object being written, elements of arrays have no name
+inline void
+json_key(string& out, const char* name) {
+    if(name == nullptr) {
+        return;
+    }
+    if(out.back() != '{') {
+        out += ',';
+    }
+    out += '"';
+    out += name;
+    out += "\":";
+}
+
 struct abi_to_variant {
     /**
        * template which overloads add for types which are not relvant to ABI information
@@ -429,6 +544,247 @@ private:
     Resolver              _resolver;
 };
 
+struct abi_to_json {
+    /**
+       * template which overloads add for types which are not relvant to ABI information
+       * and can be degraded to the normal fc::json::to_string(...) processing
+       */
+    template <typename M, typename Resolver, not_require_abi_t<M> = 1>
+    static void
+    add(string& out, const char* name, const M& v, Resolver) {
+        json_key(out, name);
+        out += fc::json::to_string(v);
+    }
+
+    /**
+       * template which overloads add for types which contain ABI information in their trees
+       * for these types we create new ABI aware visitors
+       */
+    template <typename M, typename Resolver, require_abi_t<M> = 1>
+    static void add(string& out, const char* name, const M& v, Resolver resolver);
+
+    template <typename M, typename Resolver, require_abi_t<M> = 1>
+    static void
+    add(string& out, const char* name, const vector<M>& v, Resolver resolver) {
+        json_key(out, name);
+        out += '[';
+        for(const auto& iter : v) {
+            if(out.back() != '[') {
+                out += ',';
+            }
+            add(out, nullptr, iter, resolver);
+        }
+        out += ']';
+    }
+
+    template <typename M, typename Resolver, require_abi_t<M> = 1>
+    static void
+    add(string& out, const char* name, const std::shared_ptr<M>& v, Resolver resolver) {
+        if(!v) return;
+        add(out, name, *v, resolver);
+    }
+
+    template <typename Resolver>
+    struct add_static_variant {
+        string&     out;
+        const char* name;
+        Resolver&   resolver;
+        add_static_variant(string& o, const char* n, Resolver& r)
+            : out(o)
+            , name(n)
+            , resolver(r) {}
+
+        typedef void result_type;
+        template <typename T>
+        void
+        operator()(T& v) const {
+            add(out, name, v, resolver);
+        }
+    };
+
+    template <typename Resolver, typename... Args>
+    static void
+    add(string& out, const char* name, const fc::static_variant<Args...>& v, Resolver resolver) {
+        add_static_variant<Resolver> adder(out, name, resolver);
+        v.visit(adder);
+    }
+
+    /**
+       * overload for actions, data is written from binary by walking the struct definitions
+       */
+    template <typename Resolver>
+    static void
+    add(string& out, const char* name, const action& act, Resolver resolver) {
+        json_key(out, name);
+        out += '{';
+        add(out, "name", act.name, resolver);
+        add(out, "domain", act.domain, resolver);
+        add(out, "key", act.key, resolver);
+
+        const auto& abi = resolver();
+        auto  type = abi.get_action_type(act.name);
+        auto  ds   = fc::datastream<const char*>(act.data.data(), act.data.size());
+        json_key(out, "data");
+        abi.binary_to_json(type, ds, out);
+        add(out, "hex_data", act.data, resolver);
+        out += '}';
+    }
+
+    template <typename Resolver>
+    static void
+    add(string& out, const char* name, const packed_transaction& ptrx, Resolver resolver) {
+        json_key(out, name);
+        out += '{';
+        auto trx = ptrx.get_transaction();
+        add(out, "id", trx.id(), resolver);
+        add(out, "signatures", ptrx.signatures, resolver);
+        add(out, "compression", ptrx.compression, resolver);
+        add(out, "packed_trx", ptrx.packed_trx, resolver);
+        add(out, "transaction", trx, resolver);
+        out += '}';
+    }
+};
+
+template <typename T, typename Resolver>
+class abi_to_json_visitor {
+public:
+    abi_to_json_visitor(string& _out, const T& _val, Resolver _resolver)
+        : _out(_out)
+        , _val(_val)
+        , _resolver(_resolver) {}
+
+    template <typename Member, class Class, Member(Class::*member)>
+    void
+    operator()(const char* name) const {
+        abi_to_json::add(_out, name, (_val.*member), _resolver);
+    }
+
+private:
+    string&  _out;
+    const T& _val;
+    Resolver _resolver;
+};
+
+struct abi_from_json {
+    /**
+       * template which overloads extract for types which are not relvant to ABI information
+       * and can be degraded to the normal ::from_variant(...) processing
+       */
+    template <typename M, typename Resolver, not_require_abi_t<M> = 1>
+    static void
+    extract(const json_slice& v, M& o, Resolver) {
+        from_variant(json_to_variant(v), o);
+    }
+
+    /**
+       * template which overloads extract for types which contain ABI information in their trees
+       * for these types we create new ABI aware visitors
+       */
+    template <typename M, typename Resolver, require_abi_t<M> = 1>
+    static void extract(const json_slice& v, M& o, Resolver resolver);
+
+    template <typename M, typename Resolver, require_abi_t<M> = 1>
+    static void
+    extract(const json_slice& v, vector<M>& o, Resolver resolver) {
+        auto array = json_parse_array(v);
+        o.clear();
+        o.reserve(array.size());
+        for(const auto& iter : array) {
+            M o_iter;
+            extract(iter, o_iter, resolver);
+            o.emplace_back(std::move(o_iter));
+        }
+    }
+
+    /**
+       * overload for actions, data given as object is converted into binary
+       * by walking the struct definitions directly
+       */
+    template <typename Resolver>
+    static void
+    extract(const json_slice& v, action& act, Resolver resolver) {
+        auto vo     = json_parse_object(v);
+        auto name   = vo.find("name");
+        auto domain = vo.find("domain");
+        auto key    = vo.find("key");
+        FC_ASSERT(name != nullptr);
+        FC_ASSERT(domain != nullptr);
+        FC_ASSERT(key != nullptr);
+        from_variant(json_to_variant(*name), act.name);
+        from_variant(json_to_variant(*domain), act.domain);
+        from_variant(json_to_variant(*key), act.key);
+
+        auto data = vo.find("data");
+        if(data != nullptr) {
+            if(data->is_string()) {
+                from_variant(json_to_variant(*data), act.data);
+            }
+            else if(data->is_object()) {
+                const auto& abi = resolver();
+                auto  type = abi.get_action_type(act.name);
+                act.data.clear();
+                abi.json_to_binary(type, *data, act.data);
+            }
+        }
+
+        if(act.data.empty()) {
+            auto hex_data = vo.find("hex_data");
+            if(hex_data != nullptr && hex_data->is_string()) {
+                from_variant(json_to_variant(*hex_data), act.data);
+            }
+        }
+
+        EVT_ASSERT(!act.data.empty(), packed_transaction_type_exception,
+                   "Failed to deserialize data for ${name}", ("name", act.name));
+    }
+
+    template <typename Resolver>
+    static void
+    extract(const json_slice& v, packed_transaction& ptrx, Resolver resolver) {
+        auto vo          = json_parse_object(v);
+        auto signatures  = vo.find("signatures");
+        auto compression = vo.find("compression");
+        EVT_ASSERT(signatures != nullptr, packed_transaction_type_exception, "Missing signatures");
+        EVT_ASSERT(compression != nullptr, packed_transaction_type_exception, "Missing compression");
+        from_variant(json_to_variant(*signatures), ptrx.signatures);
+        from_variant(json_to_variant(*compression), ptrx.compression);
+
+        auto packed_trx = vo.find("packed_trx");
+        if(packed_trx != nullptr && packed_trx->is_string() && packed_trx->end - packed_trx->begin > 2) {
+            from_variant(json_to_variant(*packed_trx), ptrx.packed_trx);
+            auto trx = ptrx.get_transaction();  // Validates transaction data provided.
+        }
+        else {
+            auto trx_json = vo.find("transaction");
+            EVT_ASSERT(trx_json != nullptr, packed_transaction_type_exception, "Missing transaction");
+            transaction trx;
+            extract(*trx_json, trx, resolver);
+            ptrx.set_transaction(trx, ptrx.compression);
+        }
+    }
+};
+
+template <typename T, typename Resolver>
+class abi_from_json_visitor : reflector_verifier_visitor<T> {
+public:
+    abi_from_json_visitor(const json_object& _vo, T& v, Resolver _resolver)
+        : reflector_verifier_visitor<T>(v)
+        , _vo(_vo)
+        , _resolver(_resolver) {}
+
+    template <typename Member, class Class, Member(Class::*member)>
+    void
+    operator()(const char* name) const {
+        auto itr = _vo.find(name);
+        if(itr != nullptr)
+            abi_from_json::extract(*itr, this->obj.*member, _resolver);
+    }
+
+private:
+    const json_object& _vo;
+    Resolver           _resolver;
+};
+
 template <typename M, typename Resolver, require_abi_t<M>>
 void
 abi_to_variant::add(mutable_variant_object& mvo, const char* name, const M& v, Resolver resolver) {
@@ -443,6 +799,22 @@ abi_from_variant::extract(const variant& v, M& o, Resolver resolver) {
     const variant_object& vo = v.get_object();
     fc::reflector<M>::visit(abi_from_variant_visitor<M, decltype(resolver)>(vo, o, resolver));
 }
+
+template <typename M, typename Resolver, require_abi_t<M>>
+void
+abi_to_json::add(string& out, const char* name, const M& v, Resolver resolver) {
+    json_key(out, name);
+    out += '{';
+    fc::reflector<M>::visit(impl::abi_to_json_visitor<M, Resolver>(out, v, resolver));
+    out += '}';
+}
+
+template <typename M, typename Resolver, require_abi_t<M>>
+void
+abi_from_json::extract(const json_slice& v, M& o, Resolver resolver) {
+    auto vo = json_parse_object(v);
+    fc::reflector<M>::visit(abi_from_json_visitor<M, decltype(resolver)>(vo, o, resolver));
+}
 }  // namespace impl
 
 template <typename T, typename Resolver>
@@ -461,4 +833,18 @@ abi_serializer::from_variant(const variant& v, T& o, Resolver resolver) try {
 }
 FC_RETHROW_EXCEPTIONS(error, "Failed to deserialize variant", ("variant", v))
 
+template <typename T, typename Resolver>
+void
+abi_serializer::to_json(const T& o, string& json, Resolver resolver) try {
+    impl::abi_to_json::add(json, nullptr, o, resolver);
+}
+FC_RETHROW_EXCEPTIONS(error, "Failed to serialize type", ("object", o))
+
+template <typename T, typename Resolver>
+void
+abi_serializer::from_json(const string& json, T& o, Resolver resolver) try {
+    impl::abi_from_json::extract(impl::json_parse(json), o, resolver);
+}
+FC_RETHROW_EXCEPTIONS(error, "Failed to deserialize JSON", ("json", json))
+
 }}}  // namespace evt::chain::contracts
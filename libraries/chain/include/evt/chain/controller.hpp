@@ -18,6 +18,7 @@ namespace evt { namespace chain {
 
 class fork_database;
 class token_database;
+class thread_pool;
 class apply_context;
 
 struct controller_impl;
@@ -32,14 +33,19 @@ using apply_handler = std::function<void(apply_context&)>;
 class controller {
 public:
     struct config {
-        path     blocks_dir             = chain::config::default_blocks_dir_name;
-        path     state_dir              = chain::config::default_state_dir_name;
-        path     tokendb_dir            = chain::config::default_tokendb_dir_name;
-        uint64_t state_size             = chain::config::default_state_size;
-        uint64_t reversible_cache_size  = chain::config::default_reversible_cache_size;
-        bool     read_only              = false;
-        bool     force_all_checks       = false;
-        bool     contracts_console      = false;
+        path     blocks_dir                 = chain::config::default_blocks_dir_name;
+        path     blocks_archive_dir         = chain::config::default_blocks_archive_dir_name;
+        path     state_dir                  = chain::config::default_state_dir_name;
+        path     tokendb_dir                = chain::config::default_tokendb_dir_name;
+        uint64_t tokendb_cache_size         = chain::config::default_tokendb_cache_size;
+        uint64_t state_size                 = chain::config::default_state_size;
+        uint64_t reversible_cache_size      = chain::config::default_reversible_cache_size;
+        uint16_t thread_pool_size           = chain::config::default_controller_thread_pool_size;
+        uint32_t blog_flush_interval_blocks = chain::config::default_block_log_flush_interval_blocks;
+        uint32_t blog_flush_interval_ms     = chain::config::default_block_log_flush_interval_ms;
+        bool     read_only                  = false;
+        bool     force_all_checks           = false;
+        bool     contracts_console          = false;
 
         genesis_state genesis;
     };
@@ -121,6 +127,9 @@ public:
     signed_block_ptr fetch_block_by_number(uint32_t block_num) const;
     signed_block_ptr fetch_block_by_id(block_id_type id) const;
 
+    // only reads irreversible blocks from block log, it's safe to be called from any thread
+    signed_block_ptr fetch_irreversible_block_by_number(uint32_t block_num) const;
+
     block_state_ptr fetch_block_state_by_number(uint32_t block_num) const;
     block_state_ptr fetch_block_state_by_id(block_id_type id) const;
 
@@ -141,6 +150,12 @@ public:
 
     chain_id_type get_chain_id() const;
 
+    // shared worker threads for context-free work, never touch chain state in it
+    thread_pool& get_thread_pool();
+
+    // flushes the blocks buffered by block log longer than its flush interval, should be called periodically
+    void flush_block_log();
+
     signal<void(const block_state_ptr&)>          accepted_block_header;
     signal<void(const block_state_ptr&)>          accepted_block;
     signal<void(const block_state_ptr&)>          irreversible_block;
@@ -160,7 +175,7 @@ public:
     to_variant_with_abi(const T& obj) {
         // TODO: Remove account parameter
         fc::variant pretty_output;
-        abi_serializer::to_variant(obj, pretty_output, [&] { return get_abi_serializer(); });
+        abi_serializer::to_variant(obj, pretty_output, [&]() -> const abi_serializer& { return get_abi_serializer(); });
         return pretty_output;
     }
 
@@ -171,4 +186,4 @@ private:
 }}  // namespace evt::chain
 
 FC_REFLECT(evt::chain::controller::config,
-           (blocks_dir)(state_dir)(tokendb_dir)(state_size)(reversible_cache_size)(read_only)(force_all_checks)(contracts_console)(genesis))
+           (blocks_dir)(blocks_archive_dir)(state_dir)(tokendb_dir)(tokendb_cache_size)(state_size)(reversible_cache_size)(thread_pool_size)(blog_flush_interval_blocks)(blog_flush_interval_ms)(read_only)(force_all_checks)(contracts_console)(genesis))
@@ -178,6 +178,7 @@ FC_DECLARE_DERIVED_EXCEPTION( tokendb_delay_not_found,           tokendb_excepti
 FC_DECLARE_DERIVED_EXCEPTION( tokendb_rocksdb_fail,              tokendb_exception, 3150011, "Rocksdb internal error occurred" );
 FC_DECLARE_DERIVED_EXCEPTION( tokendb_no_savepoint,              tokendb_exception, 3150012, "No savepoints anymore" );
 FC_DECLARE_DERIVED_EXCEPTION( tokendb_seq_not_valid,             tokendb_exception, 3150013, "Seq for checkpoint is not valid" );
+FC_DECLARE_DERIVED_EXCEPTION( tokendb_legacy_layout,             tokendb_exception, 3150014, "Token database uses legacy layout" );
 
 FC_DECLARE_DERIVED_EXCEPTION( unknown_block_exception,           misc_exception, 3100002, "unknown block" );
 FC_DECLARE_DERIVED_EXCEPTION( unknown_transaction_exception,     misc_exception, 3100003, "unknown transaction" );
@@ -39,6 +39,12 @@ public:
      */
     void set(block_state_ptr s);
 
+    /**
+     *  Drop all the block states and use the provided one as the only one and head.
+     *  The provided one is taken as already irreversible, it is not signaled again when it is pruned.
+     */
+    void reset(block_state_ptr s);
+
     /** this method will attempt to append the block to an exsting
      * block_state and will return a pointer to the new block state or
      * throw on error.
@@ -261,8 +261,72 @@ public:
     Container<DigestType, Args...> _active_nodes;
 };
 
+/**
+ * Builds the same root as `merkle()` while the leaves are appended one by one.
+ *
+ * Only fully-realized sub-trees are kept, one per level, so appending costs one hash amortized
+ * and the final root only needs to fold the partial right edge of the tree, which is O(log(n)).
+ * Bit `i` of the node count tells whether level `i` holds a realized sub-tree waiting for its right sibling.
+ */
+template <typename DigestType>
+class incremental_merkle_builder {
+public:
+    incremental_merkle_builder()
+        : _node_count(0) {}
+
+    void
+    append(const DigestType& digest) {
+        auto top   = digest;
+        auto level = 0u;
+        while((_node_count >> level) & 0x1) {
+            top = DigestType::hash(make_canonical_pair(_nodes[level], top));
+            level++;
+        }
+        if(level >= _nodes.size()) {
+            _nodes.resize(level + 1);
+        }
+        _nodes[level] = top;
+        _node_count++;
+    }
+
+    DigestType
+    get_root() const {
+        if(_node_count == 0) {
+            return DigestType();
+        }
+
+        // odd nodes on the right edge are paired with themselves, same as `merkle()` does
+        auto highest = detail::clz_power_2(detail::next_power_of_2(_node_count + 1) >> 1);
+        auto carry   = optional<DigestType>();
+        for(auto level = 0; level < highest; level++) {
+            auto realized = (_node_count >> level) & 0x1;
+            if(realized && carry) {
+                carry = DigestType::hash(make_canonical_pair(_nodes[level], *carry));
+            }
+            else if(realized) {
+                carry = DigestType::hash(make_canonical_pair(_nodes[level], _nodes[level]));
+            }
+            else if(carry) {
+                carry = DigestType::hash(make_canonical_pair(*carry, *carry));
+            }
+        }
+        if(carry) {
+            return DigestType::hash(make_canonical_pair(_nodes[highest], *carry));
+        }
+        return _nodes[highest];
+    }
+
+    uint64_t
+    size() const { return _node_count; }
+
+private:
+    uint64_t           _node_count;
+    vector<DigestType> _nodes;
+};
+
 typedef incremental_merkle_impl<digest_type>                incremental_merkle;
 typedef incremental_merkle_impl<digest_type, shared_vector> shared_incremental_merkle;
+typedef incremental_merkle_builder<digest_type>             merkle_builder;
 
 }}  // namespace evt::chain
 
@@ -0,0 +1,118 @@
+/**
+ *  @file
+ *  @copyright defined in evt/LICENSE.txt
+ */
+#pragma once
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <boost/asio/io_service.hpp>
+#include <boost/noncopyable.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/optional.hpp>
+
+namespace evt { namespace chain {
+
+namespace __internal {
+
+template <typename R, typename F>
+void
+fulfill_promise(std::promise<R>& p, F& f) {
+    p.set_value(f());
+}
+
+template <typename F>
+void
+fulfill_promise(std::promise<void>& p, F& f) {
+    f();
+    p.set_value();
+}
+
+}  // namespace __internal
+
+/**
+ * Fixed size pool of worker threads used to offload CPU heavy and context-free work from the main thread.
+ * Tasks are run in the order they are posted, but they may complete in any order.
+ */
+class thread_pool : boost::noncopyable {
+public:
+    thread_pool(size_t size)
+        : work_(boost::asio::io_service::work(ios_)) {
+        for(auto i = 0u; i < size; i++) {
+            threads_.emplace_back([this] {
+                while(true) {
+                    try {
+                        ios_.run();
+                        break;
+                    }
+                    catch(const fc::exception& e) {
+                        elog("Exception in thread pool: ${e}", ("e", e.to_detail_string()));
+                    }
+                    catch(const std::exception& e) {
+                        elog("Exception in thread pool: ${e}", ("e", e.what()));
+                    }
+                }
+            });
+        }
+    }
+
+    ~thread_pool() {
+        stop();
+    }
+
+public:
+    /**
+     * Post a task into the pool, result or exception of the task is passed by the returned future.
+     * Task is destroyed as soon as it's done, so it can safely hold the objects which keep the future.
+     */
+    template <typename F>
+    auto
+    post(F&& f) {
+        using result_type = decltype(f());
+
+        auto p      = std::make_shared<std::promise<result_type>>();
+        auto future = p->get_future();
+        auto task   = [p, f = std::forward<F>(f)]() mutable {
+            try {
+                __internal::fulfill_promise(*p, f);
+            }
+            catch(...) {
+                p->set_exception(std::current_exception());
+            }
+        };
+        if(threads_.empty()) {
+            // pool without threads runs tasks in place
+            task();
+            return future;
+        }
+        ios_.post(std::move(task));
+        return future;
+    }
+
+    boost::asio::io_service&
+    get_io_service() { return ios_; }
+
+    size_t
+    size() const { return threads_.size(); }
+
+    // tasks already posted are finished before threads exit
+    void
+    stop() {
+        if(!work_.valid()) {
+            return;
+        }
+        work_.reset();
+        for(auto& t : threads_) {
+            t.join();
+        }
+        threads_.clear();
+    }
+
+private:
+    boost::asio::io_service                     ios_;
+    fc::optional<boost::asio::io_service::work> work_;
+    std::vector<std::thread>                    threads_;
+};
+
+}}  // namespace evt::chain
@@ -4,13 +4,19 @@
 */
 #pragma once
 #include <deque>
+#include <vector>
 #include <boost/noncopyable.hpp>
+#include <evt/chain/config.hpp>
 #include <evt/chain/contracts/types.hpp>
+#include <evt/chain/token_database_cache.hpp>
 #include <functional>
 #include <rocksdb/options.h>
 
 namespace rocksdb {
 class DB;
+class Snapshot;
+class ColumnFamilyHandle;
+class WriteBatchWithIndex;
 }  // namespace rocksdb
 
 namespace evt { namespace chain {
@@ -23,16 +29,31 @@ using read_group_func   = std::function<void(const group_def&)>;
 using read_account_func = std::function<void(const account_def&)>;
 using read_delay_func   = std::function<void(const delay_def&)>;
 
+// used by iterations, return false to stop iterating
+using read_domains_func = std::function<bool(const domain_def&)>;
+using read_tokens_func  = std::function<bool(const token_def&)>;
+using read_groups_func  = std::function<bool(const group_def&)>;
+
+namespace __internal {
+template <typename T>
+struct object_traits;
+struct iterate_range;
+}  // namespace __internal
+
 class token_database : boost::noncopyable {
 private:
-    struct dbaction {
-        int   type;
-        void* data;
-    };
+    template <typename K, typename T, typename Hash = name128_hash>
+    using overlay_map = std::unordered_map<K, std::shared_ptr<const T>, Hash>;
+
+    // Pending changes made after the savepoint was added, a null value means the key is removed.
+    // Changes are only written into rocksdb when the savepoint is popped.
     struct savepoint {
-        int32_t               seq;
-        const void*           rb_snapshot;
-        std::vector<dbaction> actions;
+        int32_t                                                                    seq;
+        overlay_map<domain_name, domain_def>                                       domains;
+        overlay_map<std::pair<domain_name, token_name>, token_def, token_key_hash> tokens;
+        overlay_map<group_name, group_def>                                         groups;
+        overlay_map<account_name, account_def>                                     accounts;
+        overlay_map<proposal_name, delay_def>                                      delays;
     };
 
 public:
@@ -68,16 +89,48 @@ public:
         int             _accept;
     };
 
+    /**
+     * Read-only view of the objects persisted in rocksdb when it's taken. Pending changes in savepoints
+     * are not visible, so it reflects the state of the last irreversible block.
+     * Unlike other reads, it can be used from any thread while the database is being modified.
+     */
+    class snapshot : boost::noncopyable {
+    public:
+        snapshot(const token_database& token_db);
+        ~snapshot();
+
+    public:
+        int exists_domain(const domain_name&) const;
+
+        int read_domain(const domain_name&, const read_domain_func&) const;
+        int read_token(const domain_name&, const token_name&, const read_token_func&) const;
+        int read_group(const group_name&, const read_group_func&) const;
+        int read_account(const account_name&, const read_account_func&) const;
+
+        int read_domains(const optional<domain_name>& start, const read_domains_func&) const;
+        int read_tokens(const domain_name& domain, const optional<token_name>& start, const read_tokens_func&) const;
+        int read_groups(const optional<group_name>& start, const read_groups_func&) const;
+
+    private:
+        template <typename T>
+        std::shared_ptr<const T> get_object(const typename __internal::object_traits<T>::key_type& key) const;
+
+    private:
+        const token_database&    _token_db;
+        const rocksdb::Snapshot* _snapshot;
+        rocksdb::ReadOptions     _read_opts;
+    };
+
 public:
-    token_database()
-        : db_(nullptr)
-        , read_opts_()
-        , write_opts_() {}
-    token_database(const fc::path& dbpath);
+    token_database();
+    token_database(const fc::path& dbpath, size_t cache_size = config::default_tokendb_cache_size);
     ~token_database();
 
 public:
-    int initialize(const fc::path& dbpath);
+    int initialize(const fc::path& dbpath, size_t cache_size = config::default_tokendb_cache_size);
+
+    // convert the database of legacy single column family layout, returns the path of the backup
+    static fc::path upgrade_layout(const fc::path& dbpath);
 
 public:
     int add_domain(const domain_def&);
@@ -97,6 +150,12 @@ public:
     int read_account(const account_name&, const read_account_func&) const;
     int read_delay(const proposal_name&, const read_delay_func&) const;
 
+    // iterate objects in the order of keys, pending changes in savepoints are included.
+    // iteration starts right after `start` if it's provided, so the last name of one page is the cursor of next page.
+    int read_domains(const optional<domain_name>& start, const read_domains_func&) const;
+    int read_tokens(const domain_name& domain, const optional<token_name>& start, const read_tokens_func&) const;
+    int read_groups(const optional<group_name>& start, const read_groups_func&) const;
+
     // specific function, use merge operator to speed up rocksdb action.
     int update_domain(const updatedomain& ud);
     int update_group(const updategroup& ug);
@@ -109,19 +168,49 @@ public:
     int rollback_to_latest_savepoint();
     int pop_savepoints(int32_t until);
 
+    // write all the changes of popped savepoints into rocksdb in one batch
+    int flush();
+
     session new_savepoint_session(int seq);
 
+    std::unique_ptr<snapshot> new_snapshot() const;
+
+public:
+    // load objects from rocksdb into cache ahead of time, they can be called from other threads
+    // but must not run concurrently with `pop_savepoints` or `flush`.
+    void prefetch_domain(const domain_name&) const;
+    void prefetch_token(const domain_name&, const token_name&) const;
+    void prefetch_group(const group_name&) const;
+    void prefetch_account(const account_name&) const;
+    void prefetch_delay(const proposal_name&) const;
+
+public:
+    token_database_cache_stats get_cache_stats() const;
+
 private:
-    int
-    should_record() { return !savepoints_.empty(); }
-    int record(int type, void* data);
-    int free_savepoint(savepoint&);
+    template <typename T>
+    std::shared_ptr<const T> get_object(const typename __internal::object_traits<T>::key_type& key) const;
+    template <typename T>
+    void put_object(const typename __internal::object_traits<T>::key_type& key, std::shared_ptr<const T> v);
+    template <typename T, typename U>
+    void update_object(const typename __internal::object_traits<T>::key_type& key, const U& u);
+    template <typename T>
+    void prefetch_object(const typename __internal::object_traits<T>::key_type& key) const;
+    // pending changes in savepoints and batch are merged into the results only when `pendings` is set
+    template <typename T>
+    void read_objects(const rocksdb::ReadOptions& read_opts, bool pendings, const __internal::iterate_range& range,
+                      const std::function<bool(const T&)>& func) const;
+
+    int persist_savepoints(int32_t until);
 
 private:
-    rocksdb::DB*                 db_;
-    rocksdb::ReadOptions         read_opts_;
-    rocksdb::WriteOptions        write_opts_;
-    std::deque<savepoint>        savepoints_;
+    rocksdb::DB*                                  db_;
+    std::vector<rocksdb::ColumnFamilyHandle*>     handles_;
+    rocksdb::ReadOptions                          read_opts_;
+    rocksdb::WriteOptions                         write_opts_;
+    std::deque<savepoint>                         savepoints_;
+    std::unique_ptr<rocksdb::WriteBatchWithIndex> batch_;
+    std::unique_ptr<token_database_cache>         cache_;
 };
 
 }}  // namespace evt::chain
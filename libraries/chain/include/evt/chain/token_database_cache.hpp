@@ -0,0 +1,236 @@
+/**
+ *  @file
+ *  @copyright defined in evt/LICENSE.txt
+ */
+#pragma once
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <boost/noncopyable.hpp>
+#include <evt/chain/contracts/types.hpp>
+
+namespace evt { namespace chain {
+
+using namespace evt::chain::contracts;
+
+/**
+ * Sharded LRU cache of decoded objects.
+ *
+ * Values are stored as immutable shared pointers, updating an entry replaces the pointer
+ * so readers which still hold the old object are never affected.
+ * Each shard has its own lock and LRU list, the key's hash decides which shard it lives in.
+ */
+template <typename Key, typename Value, typename Hash>
+class lru_cache : boost::noncopyable {
+public:
+    using value_ptr = std::shared_ptr<const Value>;
+
+private:
+    static const size_t kShardCount = 16;
+
+    struct shard {
+        using entry     = std::pair<Key, value_ptr>;
+        using list_type = std::list<entry>;
+
+        std::mutex                                                  mutex;
+        list_type                                                   lru;
+        std::unordered_map<Key, typename list_type::iterator, Hash> index;
+    };
+
+public:
+    lru_cache(size_t capacity)
+        : shard_capacity_((capacity + kShardCount - 1) / kShardCount)
+        , hits_(0)
+        , misses_(0) {}
+
+public:
+    value_ptr
+    lookup(const Key& key) {
+        auto& s = get_shard(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        auto it = s.index.find(key);
+        if(it == s.index.end()) {
+            misses_++;
+            return value_ptr();
+        }
+        // move to the front of lru list
+        s.lru.splice(s.lru.begin(), s.lru, it->second);
+        hits_++;
+        return it->second->second;
+    }
+
+    void
+    put(const Key& key, value_ptr value) {
+        if(shard_capacity_ == 0) {
+            return;
+        }
+        auto& s = get_shard(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        auto it = s.index.find(key);
+        if(it != s.index.end()) {
+            it->second->second = std::move(value);
+            s.lru.splice(s.lru.begin(), s.lru, it->second);
+            return;
+        }
+        s.lru.emplace_front(key, std::move(value));
+        s.index.emplace(key, s.lru.begin());
+        if(s.lru.size() > shard_capacity_) {
+            s.index.erase(s.lru.back().first);
+            s.lru.pop_back();
+        }
+    }
+
+    /**
+     * Replace the cached value only if the key is cached, won't affect the order of lru list.
+     */
+    void
+    replace(const Key& key, value_ptr value) {
+        auto& s = get_shard(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        auto it = s.index.find(key);
+        if(it == s.index.end()) {
+            return;
+        }
+        it->second->second = std::move(value);
+    }
+
+    /**
+     * Replace the cached value with the result of `func` if the key is cached.
+     * `func` receives a copy of the current value which it can modify in-place.
+     */
+    template <typename Func>
+    void
+    update(const Key& key, Func&& func) {
+        auto& s = get_shard(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        auto it = s.index.find(key);
+        if(it == s.index.end()) {
+            return;
+        }
+        auto v = std::make_shared<Value>(*it->second->second);
+        func(*v);
+        it->second->second = std::move(v);
+    }
+
+    void
+    erase(const Key& key) {
+        auto& s = get_shard(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        auto it = s.index.find(key);
+        if(it == s.index.end()) {
+            return;
+        }
+        s.lru.erase(it->second);
+        s.index.erase(it);
+    }
+
+    void
+    clear() {
+        for(auto& s : shards_) {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            s.index.clear();
+            s.lru.clear();
+        }
+    }
+
+    uint64_t
+    hits() const { return hits_; }
+
+    uint64_t
+    misses() const { return misses_; }
+
+private:
+    shard&
+    get_shard(const Key& key) {
+        return shards_[Hash()(key) % kShardCount];
+    }
+
+private:
+    size_t                shard_capacity_;
+    shard                 shards_[kShardCount];
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+};
+
+// std::hash<name128> only takes the low 64 bits, which are all zero for short names
+struct name128_hash {
+    size_t
+    operator()(const name128& name) const noexcept {
+        auto lo = std::hash<uint64_t>()((uint64_t)name.value);
+        auto hi = std::hash<uint64_t>()((uint64_t)(name.value >> 64));
+        return lo ^ (hi + 0x9e3779b9 + (lo << 6) + (lo >> 2));
+    }
+};
+
+struct token_key_hash {
+    size_t
+    operator()(const std::pair<domain_name, token_name>& key) const noexcept {
+        auto h1 = name128_hash()(key.first);
+        auto h2 = name128_hash()(key.second);
+        return h1 ^ (h2 + 0x9e3779b9 + (h1 << 6) + (h1 >> 2));
+    }
+};
+
+struct token_database_cache_stats {
+    uint64_t domain_hits;
+    uint64_t domain_misses;
+    uint64_t token_hits;
+    uint64_t token_misses;
+    uint64_t group_hits;
+    uint64_t group_misses;
+    uint64_t account_hits;
+    uint64_t account_misses;
+    uint64_t delay_hits;
+    uint64_t delay_misses;
+};
+
+/**
+ * Typed object caches used by token_database, one per kind of entity.
+ * Only objects which exist in the database are cached, misses always go to rocksdb.
+ */
+struct token_database_cache {
+    token_database_cache(size_t capacity)
+        : domains(capacity)
+        , tokens(capacity)
+        , groups(capacity)
+        , accounts(capacity)
+        , delays(capacity) {}
+
+    lru_cache<domain_name, domain_def, name128_hash>                         domains;
+    lru_cache<std::pair<domain_name, token_name>, token_def, token_key_hash> tokens;
+    lru_cache<group_name, group_def, name128_hash>                           groups;
+    lru_cache<account_name, account_def, name128_hash>                       accounts;
+    lru_cache<proposal_name, delay_def, name128_hash>                        delays;
+
+    void
+    clear() {
+        domains.clear();
+        tokens.clear();
+        groups.clear();
+        accounts.clear();
+        delays.clear();
+    }
+
+    token_database_cache_stats
+    stats() const {
+        return token_database_cache_stats {
+            domains.hits(), domains.misses(),
+            tokens.hits(), tokens.misses(),
+            groups.hits(), groups.misses(),
+            accounts.hits(), accounts.misses(),
+            delays.hits(), delays.misses()
+        };
+    }
+};
+
+}}  // namespace evt::chain
+
+FC_REFLECT(evt::chain::token_database_cache_stats, (domain_hits)(domain_misses)(token_hits)(token_misses)
+           (group_hits)(group_misses)(account_hits)(account_misses)(delay_hits)(delay_misses));
@@ -3,7 +3,9 @@
  *  @copyright defined in evt/LICENSE.txt
  */
 #pragma once
+#include <future>
 #include <evt/chain/block.hpp>
+#include <evt/chain/thread_pool.hpp>
 #include <evt/chain/trace.hpp>
 #include <evt/chain/transaction.hpp>
 
@@ -15,12 +17,17 @@ namespace evt { namespace chain {
  */
 class transaction_metadata {
 public:
-    transaction_id_type                                      id;
-    transaction_id_type                                      signed_id;
-    signed_transaction                                       trx;
-    packed_transaction                                       packed_trx;
-    optional<pair<chain_id_type, flat_set<public_key_type>>> signing_keys;
-    bool                                                     accepted = false;
+    using signing_keys_type        = pair<chain_id_type, flat_set<public_key_type>>;
+    using signing_keys_future_type = std::shared_future<signing_keys_type>;
+
+public:
+    transaction_id_type         id;
+    transaction_id_type         signed_id;
+    signed_transaction          trx;
+    packed_transaction          packed_trx;
+    optional<signing_keys_type> signing_keys;
+    signing_keys_future_type    signing_keys_future;  ///< set when keys are being recovered by thread pool
+    bool                        accepted = false;
 
     transaction_metadata(const signed_transaction& t, packed_transaction::compression_type c = packed_transaction::none)
         : trx(t)
@@ -40,6 +47,10 @@ public:
 
     const flat_set<public_key_type>&
     recover_keys(const chain_id_type& chain_id) {
+        if(!signing_keys && signing_keys_future.valid()) {
+            // wait for the thread pool, rethrows if the recovery failed
+            signing_keys = signing_keys_future.get();
+        }
         if(!signing_keys || signing_keys->first != chain_id)  // Unlikely for more than one chain_id to be used in one nodeos instance
             signing_keys = std::make_pair(chain_id, trx.get_signature_keys(chain_id));
         return signing_keys->second;
@@ -49,6 +60,36 @@ public:
     total_actions() const {
         return trx.actions.size();
     }
+
+    /**
+     * Recover signing keys in the thread pool ahead of time, `recover_keys` will pick up the result.
+     * `on_done` is invoked in the worker thread once the recovery is finished, whether it failed or not.
+     * Should be called from the thread which owns the metadata, before anyone calls `recover_keys`.
+     */
+    static void
+    start_recover_keys(const std::shared_ptr<transaction_metadata>& mtrx, thread_pool& pool, const chain_id_type& chain_id,
+                       std::function<void()>&& on_done = nullptr) {
+        if(mtrx->signing_keys.valid() || mtrx->signing_keys_future.valid()) {
+            if(on_done) {
+                on_done();
+            }
+            return;
+        }
+
+        auto p = std::make_shared<std::promise<signing_keys_type>>();
+        mtrx->signing_keys_future = p->get_future().share();
+        pool.post([mtrx, chain_id, p, on_done = std::move(on_done)] {
+            try {
+                p->set_value(std::make_pair(chain_id, mtrx->trx.get_signature_keys(chain_id)));
+            }
+            catch(...) {
+                p->set_exception(std::current_exception());
+            }
+            if(on_done) {
+                on_done();
+            }
+        });
+    }
 };
 
 using transaction_metadata_ptr = std::shared_ptr<transaction_metadata>;
@@ -2,16 +2,22 @@
  *  @file
  *  @copyright defined in evt/LICENSE.txt
  */
+#include <string.h>
+#include <limits>
+#include <map>
 #include <boost/foreach.hpp>
 #include <evt/chain/exceptions.hpp>
 #include <evt/chain/token_database.hpp>
 #include <fc/filesystem.hpp>
 #include <fc/io/datastream.hpp>
 #include <fc/io/raw.hpp>
+#include <rocksdb/cache.h>
 #include <rocksdb/db.h>
+#include <rocksdb/filter_policy.h>
 #include <rocksdb/merge_operator.h>
 #include <rocksdb/slice_transform.h>
 #include <rocksdb/table.h>
+#include <rocksdb/utilities/write_batch_with_index.h>
 
 namespace evt { namespace chain {
 
@@ -19,55 +25,86 @@ using namespace evt::chain;
 
 namespace __internal {
 
-template <typename T, int N = sizeof(T)>
+// keys of the column families which are keyed by a single name
 struct db_key {
-    db_key(const char* prefix, const T& t)
-        : prefix(prefix)
-        , slice((const char*)this, 16 + N) {
-        static_assert(sizeof(name128) == 16, "Not valid prefix size");
-        memcpy(data, &t, N);
+    db_key(const name128& name)
+        : size(sizeof(name128)) {
+        static_assert(sizeof(name128) == 16, "Not valid name size");
+        memcpy(data, &name, sizeof(name128));
     }
 
-    db_key(name128 prefix, const T& t)
-        : prefix(prefix)
-        , slice((const char*)this, 16 + N) {
-        memcpy(data, &t, N);
+    // keys of tokens are prefixed with domain, so tokens of one domain are stored together
+    db_key(const name128& prefix, const name128& name)
+        : size(sizeof(name128) * 2) {
+        memcpy(data, &prefix, sizeof(name128));
+        memcpy(data + sizeof(name128), &name, sizeof(name128));
     }
 
-    const rocksdb::Slice&
+    // slice is built on demand, so keys can be copied or returned by value safely
+    rocksdb::Slice
     as_slice() const {
-        return slice;
+        return rocksdb::Slice(data, size);
     }
 
-    name128 prefix;
-    char    data[N];
-
-    rocksdb::Slice slice;
+    char   data[sizeof(name128) * 2];
+    size_t size;
 };
 
-db_key<domain_name>
+db_key
 get_domain_key(const domain_name& name) {
-    return db_key<domain_name>("domain", name);
+    return db_key(name);
 }
 
-db_key<token_name>
+db_key
 get_token_key(const domain_name& domain, const token_name& name) {
-    return db_key<token_name>(domain, name);
+    return db_key(domain, name);
 }
 
-db_key<group_name>
+db_key
 get_group_key(const group_name& name) {
-    return db_key<group_name>("group", name);
+    return db_key(name);
 }
 
-db_key<account_name>
+db_key
 get_account_key(const account_name& account) {
-    return db_key<account_name>("account", account);
+    return db_key(account);
 }
 
-db_key<proposal_name>
+db_key
 get_delay_key(const proposal_name& delay) {
-    return db_key<proposal_name>("delay", delay);
+    return db_key(delay);
+}
+
+// keys to iterate, objects start right after `seek` when `exclusive` is set
+struct iterate_range {
+    std::string prefix;
+    std::string seek;
+    bool        exclusive;
+};
+
+iterate_range
+get_domains_range(const optional<domain_name>& start) {
+    if(start.valid()) {
+        return iterate_range{std::string(), get_domain_key(*start).as_slice().ToString(), true};
+    }
+    return iterate_range{std::string(), std::string(), false};
+}
+
+iterate_range
+get_tokens_range(const domain_name& domain, const optional<token_name>& start) {
+    auto prefix = std::string((const char*)&domain, sizeof(domain));
+    if(start.valid()) {
+        return iterate_range{prefix, get_token_key(domain, *start).as_slice().ToString(), true};
+    }
+    return iterate_range{prefix, prefix, false};
+}
+
+iterate_range
+get_groups_range(const optional<group_name>& start) {
+    if(start.valid()) {
+        return iterate_range{std::string(), get_group_key(*start).as_slice().ToString(), true};
+    }
+    return iterate_range{std::string(), std::string(), false};
 }
 
 template <typename T>
@@ -90,7 +127,55 @@ read_value(const V& value) {
     return v;
 }
 
-class TokendbMerge : public rocksdb::MergeOperator {
+void
+apply_update(domain_def& v, const updatedomain& ud) {
+    if(ud.issue.valid()) {
+        v.issue = *ud.issue;
+    }
+    if(ud.transfer.valid()) {
+        v.transfer = *ud.transfer;
+    }
+    if(ud.manage.valid()) {
+        v.manage = *ud.manage;
+    }
+}
+
+void
+apply_update(group_def& v, const updategroup& ug) {
+    v = ug.group;
+}
+
+void
+apply_update(account_def& v, const updateaccount& ua) {
+    if(ua.owner.valid()) {
+        v.owner = *ua.owner;
+    }
+    if(ua.balance.valid()) {
+        v.balance = *ua.balance;
+    }
+    if(ua.frozen_balance.valid()) {
+        v.frozen_balance = *ua.frozen_balance;
+    }
+}
+
+void
+apply_update(delay_def& v, const updatedelay& ud) {
+    if(ud.signed_keys.valid()) {
+        v.signed_keys.reserve(v.signed_keys.size() + ud.signed_keys->size());
+        v.signed_keys.insert(v.signed_keys.end(), ud.signed_keys->cbegin(), ud.signed_keys->cend());
+    }
+    if(ud.status.valid()) {
+        v.status = *ud.status;
+    }
+}
+
+void
+apply_update(token_def& v, const transfer& tt) {
+    v.owner = tt.to;
+}
+
+// merge operator of the legacy single column family layout, only used when upgrading the database
+class LegacyTokendbMerge : public rocksdb::MergeOperator {
 public:
     virtual bool
     FullMergeV2(const MergeOperationInput& merge_in, MergeOperationOutput* merge_out) const override {
@@ -116,51 +201,29 @@ public:
             else if(merge_in.key.starts_with(DomainPrefixSlice)) {
                 // domain
                 auto v  = read_value<domain_def>(*merge_in.existing_value);
-                auto ug = read_value<updatedomain>(merge_in.operand_list[merge_in.operand_list.size() - 1]);
-                if(ug.issue.valid()) {
-                    v.issue = std::move(*ug.issue);
-                }
-                if(ug.transfer.valid()) {
-                    v.transfer = std::move(*ug.transfer);
-                }
-                if(ug.manage.valid()) {
-                    v.manage = std::move(*ug.manage);
-                }
+                auto ud = read_value<updatedomain>(merge_in.operand_list[merge_in.operand_list.size() - 1]);
+                apply_update(v, ud);
                 merge_out->new_value = get_value(v);
             }
             else if(merge_in.key.starts_with(AccountPrefixSlice)) {
                 // account
                 auto v  = read_value<account_def>(*merge_in.existing_value);
                 auto ua = read_value<updateaccount>(merge_in.operand_list[merge_in.operand_list.size() - 1]);
-                if(ua.owner.valid()) {
-                    v.owner = std::move(*ua.owner);
-                }
-                if(ua.balance.valid()) {
-                    v.balance = *ua.balance;
-                }
-                if(ua.frozen_balance.valid()) {
-                    v.frozen_balance = *ua.frozen_balance;
-                }
+                apply_update(v, ua);
                 merge_out->new_value = get_value(v);
             }
             else if(merge_in.key.starts_with(DelayPrefixSlice)) {
                 // delay
                 auto v  = read_value<delay_def>(*merge_in.existing_value);
                 auto ud = read_value<updatedelay>(merge_in.operand_list[merge_in.operand_list.size() - 1]);
-                if(ud.signed_keys.valid()) {
-                    v.signed_keys.reserve(v.signed_keys.size() + ud.signed_keys->size());
-                    v.signed_keys.insert(v.signed_keys.end(), ud.signed_keys->cbegin(), ud.signed_keys->cend());
-                }
-                if(ud.status.valid()) {
-                    v.status = *ud.status;
-                }
+                apply_update(v, ud);
                 merge_out->new_value = get_value(v);
             }
             else {
                 // token
                 auto v               = read_value<token_def>(*merge_in.existing_value);
                 auto tt              = read_value<transfer>(merge_in.operand_list[merge_in.operand_list.size() - 1]);
-                v.owner              = std::move(tt.to);
+                apply_update(v, tt);
                 merge_out->new_value = get_value(v);
             }
         }
@@ -187,131 +250,637 @@ public:
     }
 };
 
-enum dbaction_type {
-    none = 0,
-    kNewDomain,
-    kIssueToken,
-    kAddGroup,
-    kNewAccount,
-    kUpdateDomain,
-    kUpdateGroup,
-    kUpdateToken,
-    kUpdateAccount,
-    kNewDelay,
-    kUpdateDelay
-};
+// each column family only stores one type of object, so the merge operator needn't check the key
+template <typename T, typename U>
+class TokendbMerge : public rocksdb::MergeOperator {
+public:
+    TokendbMerge(const char* name)
+        : name_(name) {}
 
-struct sp_newdomain {
-    domain_name name;
-};
+public:
+    virtual bool
+    FullMergeV2(const MergeOperationInput& merge_in, MergeOperationOutput* merge_out) const override {
+        if(merge_in.existing_value == nullptr) {
+            return false;
+        }
+        try {
+            // merge only need to consider latest one
+            auto v = read_value<T>(*merge_in.existing_value);
+            auto u = read_value<U>(merge_in.operand_list[merge_in.operand_list.size() - 1]);
+            apply_update(v, u);
+            merge_out->new_value = get_value(v);
+        }
+        catch(fc::exception& e) {
+            return false;
+        }
+        return true;
+    }
 
-struct sp_issuetoken {
-    domain_name domain;
-    size_t      size;
-    token_name  names[0];
-};
+    virtual bool
+    PartialMerge(const rocksdb::Slice& key, const rocksdb::Slice& left_operand, const rocksdb::Slice& right_operand,
+                 std::string* new_value, rocksdb::Logger* logger) const override {
+        *new_value = right_operand.ToString();
+        return true;
+    }
 
-struct sp_addgroup {
-    group_name name;
+    virtual const char*
+    Name() const override {
+        return name_;
+    };
+    virtual bool
+    AllowSingleOperand() const override {
+        return true;
+    }
+
+private:
+    const char* name_;
 };
 
-struct sp_newaccount {
-    account_name name;
+enum column_family {
+    kDefault = 0,
+    kDomains,
+    kTokens,
+    kGroups,
+    kAccounts,
+    kDelays,
+    kColumnFamilyCount
 };
 
-struct sp_updatedomain {
-    domain_name name;
+const char* column_family_names[] = {
+    "default", "domains", "tokens", "groups", "accounts", "delays"
 };
 
-struct sp_updategroup {
-    group_name name;
+// domains, groups and delays are rarely written, don't waste memory on their memtables
+void
+set_small_memtable(rocksdb::ColumnFamilyOptions& options) {
+    options.write_buffer_size       = 2 * 1024 * 1024;
+    options.max_write_buffer_number = 2;
+}
+
+rocksdb::ColumnFamilyOptions
+get_column_family_options(int cf, const std::shared_ptr<rocksdb::Cache>& block_cache) {
+    using namespace rocksdb;
+
+    ColumnFamilyOptions options;
+    options.compression            = CompressionType::kLZ4Compression;
+    options.bottommost_compression = CompressionType::kZSTD;
+
+    BlockBasedTableOptions table_options;
+    table_options.block_cache = block_cache;
+    // most of the reads are point lookups, and lots of them are existence checks of new objects
+    table_options.filter_policy.reset(NewBloomFilterPolicy(10, false));
+
+    switch(cf) {
+    case kDomains: {
+        set_small_memtable(options);
+        options.merge_operator = std::make_shared<TokendbMerge<domain_def, updatedomain>>("Tokendb.domains");
+        break;
+    }
+    case kTokens: {
+        // tokens are the hot and the biggest set, iterating tokens of one domain is done by prefix
+        options.write_buffer_size       = 64 * 1024 * 1024;
+        options.max_write_buffer_number = 4;
+        options.prefix_extractor.reset(NewFixedPrefixTransform(sizeof(name128)));
+        table_options.block_size          = 16 * 1024;
+        table_options.whole_key_filtering = true;
+        options.merge_operator = std::make_shared<TokendbMerge<token_def, transfer>>("Tokendb.tokens");
+        break;
+    }
+    case kGroups: {
+        set_small_memtable(options);
+        options.merge_operator = std::make_shared<TokendbMerge<group_def, updategroup>>("Tokendb.groups");
+        break;
+    }
+    case kAccounts: {
+        options.write_buffer_size = 16 * 1024 * 1024;
+        options.merge_operator = std::make_shared<TokendbMerge<account_def, updateaccount>>("Tokendb.accounts");
+        break;
+    }
+    case kDelays: {
+        set_small_memtable(options);
+        options.merge_operator = std::make_shared<TokendbMerge<delay_def, updatedelay>>("Tokendb.delays");
+        break;
+    }
+    default: {
+        break;
+    }
+    }  // switch
+    options.table_factory.reset(NewBlockBasedTableFactory(table_options));
+    return options;
+}
+
+template <typename T>
+struct object_traits;
+
+template <>
+struct object_traits<domain_def> {
+    using key_type = domain_name;
+    static const int cf = kDomains;
+
+    template <typename C>
+    static auto&
+    table(C& c) { return c.domains; }
+
+    static auto
+    db_key(const key_type& key) { return get_domain_key(key); }
+
+    static void
+    throw_not_found(const key_type& key) {
+        EVT_THROW(tokendb_domain_not_found, "Cannot find domain: ${name}", ("name", (std::string)key));
+    }
 };
 
-struct sp_updatetoken {
-    domain_name domain;
-    token_name  name;
+template <>
+struct object_traits<token_def> {
+    using key_type = std::pair<domain_name, token_name>;
+    static const int cf = kTokens;
+
+    template <typename C>
+    static auto&
+    table(C& c) { return c.tokens; }
+
+    static auto
+    db_key(const key_type& key) { return get_token_key(key.first, key.second); }
+
+    static void
+    throw_not_found(const key_type& key) {
+        EVT_THROW(tokendb_token_not_found, "Cannot find token: ${domain}-${name}",
+                  ("domain", (std::string)key.first)("name", (std::string)key.second));
+    }
 };
 
-struct sp_updateaccount {
-    account_name name;
+template <>
+struct object_traits<group_def> {
+    using key_type = group_name;
+    static const int cf = kGroups;
+
+    template <typename C>
+    static auto&
+    table(C& c) { return c.groups; }
+
+    static auto
+    db_key(const key_type& key) { return get_group_key(key); }
+
+    static void
+    throw_not_found(const key_type& key) {
+        EVT_THROW(tokendb_group_not_found, "Cannot find group: ${id}", ("id", key));
+    }
 };
 
-struct sp_newdelay {
-    proposal_name name;
+template <>
+struct object_traits<account_def> {
+    using key_type = account_name;
+    static const int cf = kAccounts;
+
+    template <typename C>
+    static auto&
+    table(C& c) { return c.accounts; }
+
+    static auto
+    db_key(const key_type& key) { return get_account_key(key); }
+
+    static void
+    throw_not_found(const key_type& key) {
+        EVT_THROW(tokendb_account_not_found, "Cannot find account: ${name}", ("name", (std::string)key));
+    }
 };
 
-struct sp_updatedelay {
-    proposal_name name;
+template <>
+struct object_traits<delay_def> {
+    using key_type = proposal_name;
+    static const int cf = kDelays;
+
+    template <typename C>
+    static auto&
+    table(C& c) { return c.delays; }
+
+    static auto
+    db_key(const key_type& key) { return get_delay_key(key); }
+
+    static void
+    throw_not_found(const key_type& key) {
+        EVT_THROW(tokendb_delay_not_found, "Cannot find delay: ${name}", ("name", (std::string)key));
+    }
 };
 
+template <typename Map>
+void
+flush_overlay(const Map& overlay, rocksdb::WriteBatchWithIndex& batch,
+              const std::vector<rocksdb::ColumnFamilyHandle*>& handles) {
+    using traits = object_traits<std::remove_const_t<typename Map::mapped_type::element_type>>;
+    auto handle  = handles[traits::cf];
+    for(auto& it : overlay) {
+        auto key = traits::db_key(it.first);
+        if(it.second == nullptr) {
+            batch.Delete(handle, key.as_slice());
+            continue;
+        }
+        batch.Put(handle, key.as_slice(), get_value(*it.second));
+    }
+}
+
+template <typename Map, typename Cache>
+void
+refresh_cache(const Map& overlay, Cache& cache) {
+    for(auto& it : overlay) {
+        if(it.second == nullptr) {
+            cache.erase(it.first);
+            continue;
+        }
+        cache.replace(it.first, it.second);
+    }
+}
+
 }  // namespace __internal
 
-token_database::token_database(const fc::path& dbpath)
+token_database::token_database()
+    : db_(nullptr)
+    , read_opts_()
+    , write_opts_() {}
+
+token_database::token_database(const fc::path& dbpath, size_t cache_size)
     : db_(nullptr) {
-    initialize(dbpath);
+    initialize(dbpath, cache_size);
 }
 
 token_database::~token_database() {
     if(db_ != nullptr) {
+        // persist the changes of all the remaining savepoints
+        try {
+            persist_savepoints(std::numeric_limits<int32_t>::max());
+            flush();
+        }
+        catch(const fc::exception& e) {
+            elog("Flush savepoints of token database failed: ${e}", ("e", e.to_detail_string()));
+        }
+        for(auto handle : handles_) {
+            db_->DestroyColumnFamilyHandle(handle);
+        }
+        handles_.clear();
         delete db_;
         db_ = nullptr;
     }
 }
 
 int
-token_database::initialize(const fc::path& dbpath) {
+token_database::initialize(const fc::path& dbpath, size_t cache_size) {
     using namespace rocksdb;
     using namespace __internal;
 
     assert(db_ == nullptr);
-    Options options;
-    options.create_if_missing      = true;
-    options.compression            = CompressionType::kLZ4Compression;
-    options.bottommost_compression = CompressionType::kZSTD;
-    options.table_factory.reset(NewPlainTableFactory());
-    options.prefix_extractor.reset(NewFixedPrefixTransform(sizeof(uint128_t)));
-    options.merge_operator.reset(new TokendbMerge());
+    DBOptions options;
+    options.create_if_missing              = true;
+    options.create_missing_column_families = true;
 
     if(!fc::exists(dbpath)) {
         fc::create_directories(dbpath);
     }
 
     auto native_path = dbpath.to_native_ansi_path();
-    auto status = DB::Open(options, native_path, &db_);
+
+    // database created before column families were introduced only has the default one
+    auto cf_names = std::vector<std::string>();
+    auto status   = DB::ListColumnFamilies(options, native_path, &cf_names);
+    if(status.ok() && cf_names.size() == 1) {
+        EVT_THROW(tokendb_legacy_layout, "Token database in '${path}' uses legacy layout, please upgrade it with --upgrade-tokendb",
+                  ("path", dbpath));
+    }
+
+    auto block_cache = NewLRUCache(config::default_tokendb_block_cache_size);
+    auto cfs         = std::vector<ColumnFamilyDescriptor>();
+    for(auto i = 0; i < kColumnFamilyCount; i++) {
+        cfs.emplace_back(column_family_names[i], get_column_family_options(i, block_cache));
+    }
+
+    status = DB::Open(options, native_path, cfs, &handles_, &db_);
     if(!status.ok()) {
         EVT_THROW(tokendb_rocksdb_fail, "Rocksdb internal error: ${err}", ("err", status.getState()));
     }
+    batch_ = std::make_unique<WriteBatchWithIndex>(BytewiseComparator(), 0, true /* overwrite_key */);
+    cache_ = std::make_unique<token_database_cache>(cache_size);
 
     return 0;
 }
 
-int
-token_database::add_domain(const domain_def& domain) {
+fc::path
+token_database::upgrade_layout(const fc::path& dbpath) {
+    using namespace rocksdb;
     using namespace __internal;
-    if(exists_domain(domain.name)) {
-        EVT_THROW(tokendb_domain_existed, "Domain is already existed: ${name}", ("name", (std::string)domain.name));
+
+    ilog("Upgrading token database to column family layout...");
+
+    FC_ASSERT(fc::is_directory(dbpath), "Token database not found in '${tokendb_dir}'", ("tokendb_dir", dbpath));
+
+    auto now = fc::time_point::now();
+
+    auto tokendb_dir = fc::canonical(dbpath);
+    if(tokendb_dir.filename().generic_string() == ".") {
+        tokendb_dir = tokendb_dir.parent_path();
     }
-    auto key    = get_domain_key(domain.name);
-    auto value  = get_value(domain);
-    auto status = db_->Put(write_opts_, key.as_slice(), value);
+    auto backup_dir       = tokendb_dir.parent_path();
+    auto tokendb_dir_name = tokendb_dir.filename();
+    FC_ASSERT(tokendb_dir_name.generic_string() != ".", "Invalid path to token database directory");
+    backup_dir = backup_dir / tokendb_dir_name.generic_string().append("-").append(now);
+
+    FC_ASSERT(!fc::exists(backup_dir),
+              "Cannot move existing token database directory to already existing directory '${new_tokendb_dir}'",
+              ("new_tokendb_dir", backup_dir));
+
+    fc::rename(tokendb_dir, backup_dir);
+    ilog("Moved existing token database directory to backup location: '${new_tokendb_dir}'", ("new_tokendb_dir", backup_dir));
+
+    Options legacy_options;
+    legacy_options.table_factory.reset(NewPlainTableFactory());
+    legacy_options.prefix_extractor.reset(NewFixedPrefixTransform(sizeof(name128)));
+    legacy_options.merge_operator.reset(new LegacyTokendbMerge());
+
+    DB*  legacy_db = nullptr;
+    auto status    = DB::OpenForReadOnly(legacy_options, backup_dir.to_native_ansi_path(), &legacy_db);
     if(!status.ok()) {
         EVT_THROW(tokendb_rocksdb_fail, "Rocksdb internal error: ${err}", ("err", status.getState()));
     }
-    if(should_record()) {
-        auto act  = (sp_newdomain*)malloc(sizeof(sp_newdomain));
-        act->name = domain.name;
-        record(kNewDomain, act);
+    auto legacy = std::unique_ptr<DB>(legacy_db);
+
+    token_database tokendb(tokendb_dir, 0);
+
+    auto batch       = WriteBatch();
+    auto write_batch = [&] {
+        auto status = tokendb.db_->Write(tokendb.write_opts_, &batch);
+        if(!status.ok()) {
+            EVT_THROW(tokendb_rocksdb_fail, "Rocksdb internal error: ${err}", ("err", status.getState()));
+        }
+        batch.Clear();
+    };
+
+    // legacy keys are 16 bytes prefix followed by 16 bytes name, prefix is the type name or domain of tokens.
+    // Tokens of the domains which have the same names as the types are mixed with the objects of that type,
+    // they're told apart by values: tokens start with their domain and name, same as the key, and objects
+    // start with their own names.
+    auto is_token = [](const Slice& key, const Slice& value) {
+        if(value.size() < key.size() || memcmp(value.data(), key.data(), key.size()) != 0) {
+            return false;
+        }
+        auto ds = fc::datastream<const char*>(value.data(), value.size());
+        try {
+            auto token = token_def();
+            fc::raw::unpack(ds, token);
+        }
+        catch(const fc::exception&) {
+            return false;
+        }
+        return ds.remaining() == 0;
+    };
+
+    auto ntokens     = 0u;
+    auto copy_prefix = [&](const name128& prefix, int cf, bool keep_prefix, const std::function<void(const Slice&)>& cb) {
+        auto read_opts                 = ReadOptions();
+        read_opts.prefix_same_as_start = true;
+
+        auto total  = 0u;
+        auto pslice = Slice((const char*)&prefix, sizeof(prefix));
+        auto it     = std::unique_ptr<Iterator>(legacy->NewIterator(read_opts));
+        for(it->Seek(pslice); it->Valid() && it->key().starts_with(pslice); it->Next()) {
+            auto key = it->key();
+            if(cf != kTokens && is_token(key, it->value())) {
+                batch.Put(tokendb.handles_[kTokens], key, it->value());
+                ntokens++;
+            }
+            else {
+                if(!keep_prefix) {
+                    key.remove_prefix(sizeof(name128));
+                }
+                batch.Put(tokendb.handles_[cf], key, it->value());
+                if(cb) {
+                    cb(it->value());
+                }
+                total++;
+            }
+            if(batch.Count() >= 10000) {
+                write_batch();
+            }
+        }
+        if(!it->status().ok()) {
+            EVT_THROW(tokendb_rocksdb_fail, "Rocksdb internal error: ${err}", ("err", it->status().getState()));
+        }
+        return total;
+    };
+
+    auto domains  = std::vector<domain_name>();
+    auto ndomains = copy_prefix(N128(domain), kDomains, false, [&](auto& value) {
+        domains.emplace_back(read_value<domain_def>(value).name);
+    });
+    auto ngroups   = copy_prefix(N128(group), kGroups, false, nullptr);
+    auto naccounts = copy_prefix(N128(account), kAccounts, false, nullptr);
+    auto ndelays   = copy_prefix(N128(delay), kDelays, false, nullptr);
+
+    for(auto& domain : domains) {
+        // already copied with the objects of the same prefix
+        if(domain == N128(domain) || domain == N128(group) || domain == N128(account) || domain == N128(delay)) {
+            continue;
+        }
+        ntokens += copy_prefix(domain, kTokens, true, nullptr);
+    }
+    write_batch();
+
+    ilog("Upgraded token database: ${d} domains, ${t} tokens, ${g} groups, ${a} accounts, ${dl} delays",
+         ("d", ndomains)("t", ntokens)("g", ngroups)("a", naccounts)("dl", ndelays));
+    return backup_dir;
+}
+
+template <typename T>
+std::shared_ptr<const T>
+token_database::get_object(const typename __internal::object_traits<T>::key_type& key) const {
+    using namespace __internal;
+    using traits = object_traits<T>;
+
+    // find in pending changes first, from the latest savepoint
+    for(auto it = savepoints_.crbegin(); it != savepoints_.crend(); it++) {
+        auto& overlay = traits::table(*it);
+        auto  vit     = overlay.find(key);
+        if(vit != overlay.end()) {
+            return vit->second;
+        }
+    }
+
+    auto& cache = traits::table(*cache_);
+    auto  v     = cache.lookup(key);
+    if(v) {
+        return v;
+    }
+
+    // changes of popped savepoints may still stay in the batch
+    auto        dbkey = traits::db_key(key);
+    std::string value;
+    auto        status = batch_->GetFromBatchAndDB(db_, read_opts_, handles_[traits::cf], dbkey.as_slice(), &value);
+    if(!status.ok()) {
+        return nullptr;
+    }
+    auto nv = std::make_shared<const T>(read_value<T>(value));
+    cache.put(key, nv);
+    return nv;
+}
+
+template <typename T>
+void
+token_database::put_object(const typename __internal::object_traits<T>::key_type& key, std::shared_ptr<const T> v) {
+    using namespace __internal;
+    using traits = object_traits<T>;
+
+    if(!savepoints_.empty()) {
+        traits::table(savepoints_.back())[key] = std::move(v);
+        return;
+    }
+
+    flush();
+
+    auto dbkey  = traits::db_key(key);
+    auto status = db_->Put(write_opts_, handles_[traits::cf], dbkey.as_slice(), get_value(*v));
+    if(!status.ok()) {
+        EVT_THROW(tokendb_rocksdb_fail, "Rocksdb internal error: ${err}", ("err", status.getState()));
+    }
+    traits::table(*cache_).put(key, std::move(v));
+}
+
+template <typename T, typename U>
+void
+token_database::update_object(const typename __internal::object_traits<T>::key_type& key, const U& u) {
+    using namespace __internal;
+    using traits = object_traits<T>;
+
+    if(!savepoints_.empty()) {
+        auto v = get_object<T>(key);
+        if(v == nullptr) {
+            traits::throw_not_found(key);
+        }
+        auto nv = std::make_shared<T>(*v);
+        apply_update(*nv, u);
+        traits::table(savepoints_.back())[key] = std::move(nv);
+        return;
+    }
+
+    // specific function, use merge operator to speed up rocksdb action.
+    flush();
+
+    auto dbkey  = traits::db_key(key);
+    auto status = db_->Merge(write_opts_, handles_[traits::cf], dbkey.as_slice(), get_value(u));
+    if(!status.ok()) {
+        EVT_THROW(tokendb_rocksdb_fail, "Rocksdb internal error: ${err}", ("err", status.getState()));
+    }
+    traits::table(*cache_).update(key, [&](auto& v) { apply_update(v, u); });
+}
+
+template <typename T>
+void
+token_database::prefetch_object(const typename __internal::object_traits<T>::key_type& key) const {
+    using namespace __internal;
+    using traits = object_traits<T>;
+
+    auto& cache = traits::table(*cache_);
+    if(cache.lookup(key)) {
+        return;
+    }
+
+    // pending changes are not touched here, cache only keeps the values in rocksdb
+    auto        dbkey = traits::db_key(key);
+    std::string value;
+    auto        status = db_->Get(read_opts_, handles_[traits::cf], dbkey.as_slice(), &value);
+    if(!status.ok()) {
+        return;
+    }
+    cache.put(key, std::make_shared<const T>(read_value<T>(value)));
+}
+
+template <typename T>
+void
+token_database::read_objects(const rocksdb::ReadOptions& read_opts, bool pendings, const __internal::iterate_range& range,
+                             const std::function<bool(const T&)>& func) const {
+    using namespace rocksdb;
+    using namespace __internal;
+    using traits = object_traits<T>;
+
+    auto& prefix   = range.prefix;
+    auto& seek     = range.seek;
+    auto  in_range = [&](const Slice& key) {
+        if(!key.starts_with(prefix)) {
+            return false;
+        }
+        auto r = key.compare(seek);
+        return range.exclusive ? r > 0 : r >= 0;
+    };
+
+    // pending changes in range, sorted by keys, the latest savepoint wins.
+    // savepoints are only touched on main thread, snapshots read without them from other threads
+    auto overlay = std::map<std::string, std::shared_ptr<const T>>();
+    if(pendings) {
+        for(auto it = savepoints_.crbegin(); it != savepoints_.crend(); it++) {
+            for(auto& kv : traits::table(*it)) {
+                auto key = traits::db_key(kv.first);
+                if(!in_range(key.as_slice())) {
+                    continue;
+                }
+                overlay.emplace(key.as_slice().ToString(), kv.second);
+            }
+        }
+    }
+
+    auto iter_opts                 = read_opts;
+    iter_opts.prefix_same_as_start = !prefix.empty();
+
+    // changes of popped savepoints still in the batch are merged by the iterator
+    auto handle = handles_[traits::cf];
+    auto base   = db_->NewIterator(iter_opts, handle);
+    auto it     = std::unique_ptr<Iterator>(pendings ? batch_->NewIteratorWithBase(handle, base) : base);
+    it->Seek(seek);
+    if(range.exclusive && it->Valid() && it->key() == seek) {
+        it->Next();
+    }
+
+    auto pit = overlay.cbegin();
+    while(true) {
+        auto valid = it->Valid() && in_range(it->key());
+        if(!valid && pit == overlay.cend()) {
+            break;
+        }
+
+        auto r = !valid ? 1 : (pit == overlay.cend() ? -1 : it->key().compare(pit->first));
+        auto v = std::shared_ptr<const T>();
+        if(r < 0) {
+            v = std::make_shared<const T>(read_value<T>(it->value()));
+            it->Next();
+        }
+        else {
+            // pending change overrides the one in database
+            v = pit->second;
+            if(r == 0) {
+                it->Next();
+            }
+            pit++;
+        }
+        if(v == nullptr) {
+            // removed
+            continue;
+        }
+        if(!func(*v)) {
+            break;
+        }
+    }
+    if(!it->status().ok()) {
+        EVT_THROW(tokendb_rocksdb_fail, "Rocksdb internal error: ${err}", ("err", it->status().getState()));
     }
+}
+
+int
+token_database::add_domain(const domain_def& domain) {
+    if(exists_domain(domain.name)) {
+        EVT_THROW(tokendb_domain_existed, "Domain is already existed: ${name}", ("name", (std::string)domain.name));
+    }
+    put_object<domain_def>(domain.name, std::make_shared<const domain_def>(domain));
     return 0;
 }
 
 int
 token_database::exists_domain(const domain_name& name) const {
-    using namespace __internal;
-    auto        key = get_domain_key(name);
-    std::string value;
-    auto        status = db_->Get(read_opts_, key.as_slice(), &value);
-    return status.ok();
+    return get_object<domain_def>(name) != nullptr;
 }
 
 int
@@ -320,286 +889,203 @@ token_database::issue_tokens(const issuetoken& issue) {
     if(!exists_domain(issue.domain)) {
         EVT_THROW(tokendb_domain_not_found, "Cannot find domain: ${name}", ("name", (std::string)issue.domain));
     }
+    if(!savepoints_.empty()) {
+        auto& overlay = savepoints_.back().tokens;
+        for(auto& name : issue.names) {
+            overlay[std::make_pair(issue.domain, name)] = std::make_shared<const token_def>(issue.domain, name, issue.owner);
+        }
+        return 0;
+    }
+
+    flush();
+
     rocksdb::WriteBatch batch;
     for(auto name : issue.names) {
         auto key   = get_token_key(issue.domain, name);
         auto value = get_value(token_def(issue.domain, name, issue.owner));
-        batch.Put(key.as_slice(), value);
+        batch.Put(handles_[kTokens], key.as_slice(), value);
     }
     auto status = db_->Write(write_opts_, &batch);
     if(!status.ok()) {
         EVT_THROW(tokendb_rocksdb_fail, "Rocksdb internal error: ${err}", ("err", status.getState()));
     }
-    if(should_record()) {
-        auto act    = (sp_issuetoken*)malloc(sizeof(sp_issuetoken) + sizeof(token_name) * issue.names.size());
-        act->domain = issue.domain;
-        act->size   = issue.names.size();
-        memcpy(act->names, &issue.names[0], sizeof(token_name) * act->size);
-        record(kIssueToken, act);
-    }
     return 0;
 }
 
 int
 token_database::exists_token(const domain_name& domain, const token_name& name) const {
-    using namespace __internal;
-    auto        key = get_token_key(domain, name);
-    std::string value;
-    auto        status = db_->Get(read_opts_, key.as_slice(), &value);
-    return status.ok();
+    return get_object<token_def>(std::make_pair(domain, name)) != nullptr;
 }
 
 int
 token_database::add_group(const group_def& group) {
-    using namespace __internal;
     if(exists_group(group.name())) {
         EVT_THROW(tokendb_group_existed, "Group is already existed: ${name}", ("name", group.name()));
     }
-    auto key    = get_group_key(group.name());
-    auto value  = get_value(group);
-    auto status = db_->Put(write_opts_, key.as_slice(), value);
-    if(!status.ok()) {
-        EVT_THROW(tokendb_rocksdb_fail, "Rocksdb internal error: ${err}", ("err", status.getState()));
-    }
-    if(should_record()) {
-        auto act  = (sp_addgroup*)malloc(sizeof(sp_addgroup));
-        act->name = group.name();
-        record(kAddGroup, act);
-    }
+    put_object<group_def>(group.name(), std::make_shared<const group_def>(group));
     return 0;
 }
 
 int
 token_database::exists_group(const group_name& name) const {
-    using namespace __internal;
-    auto        key = get_group_key(name);
-    std::string value;
-    auto        status = db_->Get(read_opts_, key.as_slice(), &value);
-    return status.ok();
+    return get_object<group_def>(name) != nullptr;
 }
 
 int
 token_database::add_account(const account_def& account) {
-    using namespace __internal;
     if(exists_account(account.name)) {
         EVT_THROW(tokendb_account_existed, "Account is already existed: ${name}", ("name", (std::string)account.name));
     }
-    auto key    = get_account_key(account.name);
-    auto value  = get_value(account);
-    auto status = db_->Put(write_opts_, key.as_slice(), value);
-    if(!status.ok()) {
-        EVT_THROW(tokendb_rocksdb_fail, "Rocksdb internal error: ${err}", ("err", status.getState()));
-    }
-    if(should_record()) {
-        auto act  = (sp_newaccount*)malloc(sizeof(sp_newaccount));
-        act->name = account.name;
-        record(kNewAccount, act);
-    }
+    put_object<account_def>(account.name, std::make_shared<const account_def>(account));
     return 0;
 }
 
 int
 token_database::exists_account(const account_name& name) const {
-    using namespace __internal;
-    auto        key = get_account_key(name);
-    std::string value;
-    auto        status = db_->Get(read_opts_, key.as_slice(), &value);
-    return status.ok();
+    return get_object<account_def>(name) != nullptr;
 }
 
 int
 token_database::add_delay(const delay_def& delay) {
-    using namespace __internal;
     if(exists_delay(delay.name)) {
         EVT_THROW(tokendb_delay_existed, "Delay is already existed: ${name}", ("name", (std::string)delay.name));
     }
-    auto key    = get_delay_key(delay.name);
-    auto value  = get_value(delay);
-    auto status = db_->Put(write_opts_, key.as_slice(), value);
-    if(!status.ok()) {
-        EVT_THROW(tokendb_rocksdb_fail, "Rocksdb internal error: ${err}", ("err", status.getState()));
-    }
-    if(should_record()) {
-        auto act  = (sp_newdelay*)malloc(sizeof(sp_newdelay));
-        act->name = delay.name;
-        record(kNewDelay, act);
-    }
+    put_object<delay_def>(delay.name, std::make_shared<const delay_def>(delay));
     return 0;
 }
 
 int
 token_database::exists_delay(const proposal_name& name) const {
-    using namespace __internal;
-    auto        key = get_delay_key(name);
-    std::string value;
-    auto        status = db_->Get(read_opts_, key.as_slice(), &value);
-    return status.ok();
+    return get_object<delay_def>(name) != nullptr;
 }
 
 int
 token_database::read_domain(const domain_name& name, const read_domain_func& func) const {
-    using namespace __internal;
-    std::string value;
-    auto        key    = get_domain_key(name);
-    auto        status = db_->Get(read_opts_, key.as_slice(), &value);
-    if(!status.ok()) {
-        EVT_THROW(tokendb_domain_not_found, "Cannot find domain: ${name}", ("name", (std::string)name));
+    auto v = get_object<domain_def>(name);
+    if(v == nullptr) {
+        __internal::object_traits<domain_def>::throw_not_found(name);
     }
-    auto v = read_value<domain_def>(value);
-    func(v);
+    func(*v);
     return 0;
 }
 
 int
 token_database::read_token(const domain_name& domain, const token_name& name, const read_token_func& func) const {
-    using namespace __internal;
-    std::string value;
-    auto        key    = get_token_key(domain, name);
-    auto        status = db_->Get(read_opts_, key.as_slice(), &value);
-    if(!status.ok()) {
-        EVT_THROW(tokendb_token_not_found, "Cannot find token: ${domain}-${name}",
-                  ("domain", (std::string)domain)("name", (std::string)name));
+    auto key = std::make_pair(domain, name);
+    auto v   = get_object<token_def>(key);
+    if(v == nullptr) {
+        __internal::object_traits<token_def>::throw_not_found(key);
     }
-    auto v = read_value<token_def>(value);
-    func(v);
+    func(*v);
     return 0;
 }
 
 int
 token_database::read_group(const group_name& id, const read_group_func& func) const {
-    using namespace __internal;
-    std::string value;
-    auto        key    = get_group_key(id);
-    auto        status = db_->Get(read_opts_, key.as_slice(), &value);
-    if(!status.ok()) {
-        EVT_THROW(tokendb_group_not_found, "Cannot find group: ${id}", ("id", id));
+    auto v = get_object<group_def>(id);
+    if(v == nullptr) {
+        __internal::object_traits<group_def>::throw_not_found(id);
     }
-    auto v = read_value<group_def>(value);
-    func(v);
+    func(*v);
     return 0;
 }
 
 int
 token_database::read_account(const account_name& name, const read_account_func& func) const {
-    using namespace __internal;
-    std::string value;
-    auto        key    = get_account_key(name);
-    auto        status = db_->Get(read_opts_, key.as_slice(), &value);
-    if(!status.ok()) {
-        EVT_THROW(tokendb_account_not_found, "Cannot find account: ${name}", ("name", (std::string)name));
+    auto v = get_object<account_def>(name);
+    if(v == nullptr) {
+        __internal::object_traits<account_def>::throw_not_found(name);
     }
-    auto v = read_value<account_def>(value);
-    func(v);
+    func(*v);
     return 0;
 }
 
 int
 token_database::read_delay(const proposal_name& name, const read_delay_func& func) const {
-    using namespace __internal;
-    std::string value;
-    auto        key    = get_delay_key(name);
-    auto        status = db_->Get(read_opts_, key.as_slice(), &value);
-    if(!status.ok()) {
-        EVT_THROW(tokendb_delay_not_found, "Cannot find delay: ${name}", ("name", (std::string)name));
+    auto v = get_object<delay_def>(name);
+    if(v == nullptr) {
+        __internal::object_traits<delay_def>::throw_not_found(name);
     }
-    auto v = read_value<delay_def>(value);
-    func(v);
+    func(*v);
+    return 0;
+}
+
+int
+token_database::read_domains(const optional<domain_name>& start, const read_domains_func& func) const {
+    read_objects<domain_def>(read_opts_, true, __internal::get_domains_range(start), func);
+    return 0;
+}
+
+int
+token_database::read_tokens(const domain_name& domain, const optional<token_name>& start, const read_tokens_func& func) const {
+    read_objects<token_def>(read_opts_, true, __internal::get_tokens_range(domain, start), func);
+    return 0;
+}
+
+int
+token_database::read_groups(const optional<group_name>& start, const read_groups_func& func) const {
+    read_objects<group_def>(read_opts_, true, __internal::get_groups_range(start), func);
     return 0;
 }
 
 int
 token_database::update_domain(const updatedomain& ud) {
-    using namespace __internal;
-    auto key    = get_domain_key(ud.name);
-    auto value  = get_value(ud);
-    auto status = db_->Merge(write_opts_, key.as_slice(), value);
-    if(!status.ok()) {
-        EVT_THROW(tokendb_rocksdb_fail, "Rocksdb internal error: ${err}", ("err", status.getState()));
-    }
-    if(should_record()) {
-        auto act  = (sp_updatedomain*)malloc(sizeof(sp_updatedomain));
-        act->name = ud.name;
-        record(kUpdateDomain, act);
-    }
+    update_object<domain_def>(ud.name, ud);
     return 0;
 }
 
 int
 token_database::update_group(const updategroup& ug) {
-    using namespace __internal;
-    auto key    = get_group_key(ug.name);
-    auto value  = get_value(ug);
-    auto status = db_->Merge(write_opts_, key.as_slice(), value);
-    if(!status.ok()) {
-        EVT_THROW(tokendb_rocksdb_fail, "Rocksdb internal error: ${err}", ("err", status.getState()));
-    }
-    if(should_record()) {
-        auto act  = (sp_updategroup*)malloc(sizeof(sp_updategroup));
-        act->name = ug.name;
-        record(kUpdateGroup, act);
-    }
+    update_object<group_def>(ug.name, ug);
     return 0;
 }
 
 int
 token_database::transfer_token(const transfer& tt) {
-    using namespace __internal;
-    auto key    = get_token_key(tt.domain, tt.name);
-    auto value  = get_value(tt);
-    auto status = db_->Merge(write_opts_, key.as_slice(), value);
-    if(!status.ok()) {
-        EVT_THROW(tokendb_rocksdb_fail, "Rocksdb internal error: ${err}", ("err", status.getState()));
-    }
-    if(should_record()) {
-        auto act    = (sp_updatetoken*)malloc(sizeof(sp_updatetoken));
-        act->domain = tt.domain;
-        act->name   = tt.name;
-        record(kUpdateToken, act);
-    }
+    update_object<token_def>(std::make_pair(tt.domain, tt.name), tt);
     return 0;
 }
 
 int
 token_database::update_account(const updateaccount& ua) {
-    using namespace __internal;
-    auto key    = get_account_key(ua.name);
-    auto value  = get_value(ua);
-    auto status = db_->Merge(write_opts_, key.as_slice(), value);
-    if(!status.ok()) {
-        EVT_THROW(tokendb_rocksdb_fail, "Rocksdb internal error: ${err}", ("err", status.getState()));
-    }
-    if(should_record()) {
-        auto act  = (sp_updateaccount*)malloc(sizeof(sp_updateaccount));
-        act->name = ua.name;
-        record(kUpdateAccount, act);
-    }
+    update_object<account_def>(ua.name, ua);
     return 0;
 }
 
 int
 token_database::update_delay(const updatedelay& ud) {
-    using namespace __internal;
-    auto key    = get_delay_key(ud.name);
-    auto value  = get_value(ud);
-    auto status = db_->Merge(write_opts_, key.as_slice(), value);
-    if(!status.ok()) {
-        EVT_THROW(tokendb_rocksdb_fail, "Rocksdb internal error: ${err}", ("err", status.getState()));
-    }
-    if(should_record()) {
-        auto act  = (sp_updatedelay*)malloc(sizeof(sp_updatedelay));
-        act->name = ud.name;
-        record(kUpdateDelay, act);
-    }
+    update_object<delay_def>(ud.name, ud);
     return 0;
 }
 
-int
-token_database::record(int type, void* data) {
-    if(!should_record()) {
-        return 0;
-    }
-    savepoints_.back().actions.emplace_back(dbaction{.type = type, .data = data});
-    return 0;
+void
+token_database::prefetch_domain(const domain_name& name) const {
+    prefetch_object<domain_def>(name);
+}
+
+void
+token_database::prefetch_token(const domain_name& domain, const token_name& name) const {
+    prefetch_object<token_def>(std::make_pair(domain, name));
+}
+
+void
+token_database::prefetch_group(const group_name& name) const {
+    prefetch_object<group_def>(name);
+}
+
+void
+token_database::prefetch_account(const account_name& name) const {
+    prefetch_object<account_def>(name);
+}
+
+void
+token_database::prefetch_delay(const proposal_name& name) const {
+    prefetch_object<delay_def>(name);
+}
+
+token_database_cache_stats
+token_database::get_cache_stats() const {
+    return cache_->stats();
 }
 
 token_database::session
@@ -608,6 +1094,11 @@ token_database::new_savepoint_session(int seq) {
     return session(*this, seq);
 }
 
+std::unique_ptr<token_database::snapshot>
+token_database::new_snapshot() const {
+    return std::make_unique<snapshot>(*this);
+}
+
 int
 token_database::add_savepoint(int32_t seq) {
     if(!savepoints_.empty()) {
@@ -616,16 +1107,49 @@ token_database::add_savepoint(int32_t seq) {
                       ("prev", savepoints_.back().seq)("curr", seq));
         }
     }
-    savepoints_.emplace_back(savepoint{.seq = seq, .rb_snapshot = (const void*)db_->GetSnapshot(), .actions = {}});
+    savepoints_.emplace_back();
+    savepoints_.back().seq = seq;
     return 0;
 }
 
 int
-token_database::free_savepoint(savepoint& cp) {
-    for(auto& act : cp.actions) {
-        free(act.data);
+token_database::persist_savepoints(int32_t until) {
+    using namespace __internal;
+
+    // changes in savepoints before `until` are appended into the batch,
+    // the batch is written into rocksdb by `flush`, normally once per block.
+    auto end = savepoints_.begin();
+    for(; end != savepoints_.end() && end->seq < until; end++) {
+        flush_overlay(end->domains, *batch_, handles_);
+        flush_overlay(end->tokens, *batch_, handles_);
+        flush_overlay(end->groups, *batch_, handles_);
+        flush_overlay(end->accounts, *batch_, handles_);
+        flush_overlay(end->delays, *batch_, handles_);
+    }
+
+    // cache keeps the values below all the savepoints
+    for(auto it = savepoints_.begin(); it != end; it++) {
+        refresh_cache(it->domains, cache_->domains);
+        refresh_cache(it->tokens, cache_->tokens);
+        refresh_cache(it->groups, cache_->groups);
+        refresh_cache(it->accounts, cache_->accounts);
+        refresh_cache(it->delays, cache_->delays);
+    }
+    savepoints_.erase(savepoints_.begin(), end);
+    return 0;
+}
+
+int
+token_database::flush() {
+    auto batch = batch_->GetWriteBatch();
+    if(batch->Count() == 0) {
+        return 0;
     }
-    db_->ReleaseSnapshot((const rocksdb::Snapshot*)cp.rb_snapshot);
+    auto status = db_->Write(write_opts_, batch);
+    if(!status.ok()) {
+        EVT_THROW(tokendb_rocksdb_fail, "Rocksdb internal error: ${err}", ("err", status.getState()));
+    }
+    batch_->Clear();
     return 0;
 }
 
@@ -634,144 +1158,109 @@ token_database::pop_savepoints(int32_t until) {
     if(savepoints_.empty()) {
         EVT_THROW(tokendb_no_savepoint, "There's no savepoints anymore");
     }
-    while(!savepoints_.empty() && savepoints_.front().seq < until) {
-        auto it = std::move(savepoints_.front());
-        savepoints_.pop_front();
-        free_savepoint(it);
-    }
-    return 0;
+    return persist_savepoints(until);
 }
 
 int
 token_database::rollback_to_latest_savepoint() {
-    using namespace __internal;
-
     if(savepoints_.empty()) {
         EVT_THROW(tokendb_no_savepoint, "There's no savepoints anymore");
     }
-    auto& cp = savepoints_.back();
-    if(cp.actions.size() > 0) {
-        auto snapshot_read_opts_     = read_opts_;
-        snapshot_read_opts_.snapshot = (const rocksdb::Snapshot*)cp.rb_snapshot;
-        rocksdb::WriteBatch batch;
-        for(auto it = --cp.actions.end(); it >= cp.actions.begin(); it--) {
-            switch(it->type) {
-            case kNewDomain: {
-                auto act = (sp_newdomain*)it->data;
-                auto key = get_domain_key(act->name);
-                batch.Delete(key.as_slice());
-                break;
-            }
-            case kIssueToken: {
-                auto act = (sp_issuetoken*)it->data;
-                for(size_t i = 0; i < act->size; i++) {
-                    auto key = get_token_key(act->domain, act->names[i]);
-                    batch.Delete(key.as_slice());
-                }
-                break;
-            }
-            case kAddGroup: {
-                auto act = (sp_addgroup*)it->data;
-                auto key = get_group_key(act->name);
-                batch.Delete(key.as_slice());
-                break;
-            }
-            case kNewAccount: {
-                auto act = (sp_newaccount*)it->data;
-                auto key = get_account_key(act->name);
-                batch.Delete(key.as_slice());
-                break;
-            }
-            case kUpdateDomain: {
-                auto        act = (sp_updatedomain*)it->data;
-                auto        key = get_domain_key(act->name);
-                std::string old_value;
-                auto        status = db_->Get(snapshot_read_opts_, key.as_slice(), &old_value);
-                if(!status.ok()) {
-                    // key may not existed in latest snapshot, remove it
-                    FC_ASSERT(status.code() == rocksdb::Status::kNotFound, "Not expected rocksdb code: ${status}",
-                              ("status", status.getState()));
-                    batch.Delete(key.as_slice());
-                    break;
-                }
-                batch.Put(key.as_slice(), old_value);
-                break;
-            }
-            case kUpdateGroup: {
-                auto        act = (sp_updategroup*)it->data;
-                auto        key = get_group_key(act->name);
-                std::string old_value;
-                auto        status = db_->Get(snapshot_read_opts_, key.as_slice(), &old_value);
-                if(!status.ok()) {
-                    // key may not existed in latest snapshot, remove it
-                    FC_ASSERT(status.code() == rocksdb::Status::kNotFound, "Not expected rocksdb code: ${status}",
-                              ("status", status.getState()));
-                    batch.Delete(key.as_slice());
-                    break;
-                }
-                batch.Put(key.as_slice(), old_value);
-                break;
-            }
-            case kUpdateToken: {
-                auto        act = (sp_updatetoken*)it->data;
-                auto        key = get_token_key(act->domain, act->name);
-                std::string old_value;
-                auto        status = db_->Get(snapshot_read_opts_, key.as_slice(), &old_value);
-                if(!status.ok()) {
-                    // key may not existed in latest snapshot, remove it
-                    FC_ASSERT(status.code() == rocksdb::Status::kNotFound, "Not expected rocksdb code: ${status}",
-                              ("status", status.getState()));
-                    db_->Delete(write_opts_, key.as_slice());
-                    break;
-                }
-                batch.Put(key.as_slice(), old_value);
-                break;
-            }
-            case kUpdateAccount: {
-                auto        act = (sp_updateaccount*)it->data;
-                auto        key = get_account_key(act->name);
-                std::string old_value;
-                auto        status = db_->Get(snapshot_read_opts_, key.as_slice(), &old_value);
-                if(!status.ok()) {
-                    // key may not existed in latest snapshot, remove it
-                    FC_ASSERT(status.code() == rocksdb::Status::kNotFound, "Not expected rocksdb code: ${status}",
-                              ("status", status.getState()));
-                    db_->Delete(write_opts_, key.as_slice());
-                    break;
-                }
-                batch.Put(key.as_slice(), old_value);
-                break;
-            }
-            case kUpdateDelay: {
-                auto        act = (sp_updatedelay*)it->data;
-                auto        key = get_delay_key(act->name);
-                std::string old_value;
-                auto        status = db_->Get(snapshot_read_opts_, key.as_slice(), &old_value);
-                if(!status.ok()) {
-                    // key may not existed in latest snapshot, remove it
-                    FC_ASSERT(status.code() == rocksdb::Status::kNotFound, "Not expected rocksdb code: ${status}",
-                              ("status", status.getState()));
-                    db_->Delete(write_opts_, key.as_slice());
-                    break;
-                }
-                batch.Put(key.as_slice(), old_value);
-                break;
-            }
-            default: {
-                FC_ASSERT(false, "Unexpected action type: ${type}", ("type", it->type));
-                break;
-            }
-            }  // switch
-            free(it->data);
-        }  // for
-        auto sync_write_opts = write_opts_;
-        sync_write_opts.sync = true;
-        db_->Write(sync_write_opts, &batch);
-    }  // if
-
-    db_->ReleaseSnapshot((const rocksdb::Snapshot*)cp.rb_snapshot);
+    // changes are only kept in the overlay of savepoint, just drop it
     savepoints_.pop_back();
     return 0;
 }
 
+token_database::snapshot::snapshot(const token_database& token_db)
+    : _token_db(token_db)
+    , _snapshot(token_db.db_->GetSnapshot()) {
+    _read_opts          = token_db.read_opts_;
+    _read_opts.snapshot = _snapshot;
+}
+
+token_database::snapshot::~snapshot() {
+    _token_db.db_->ReleaseSnapshot(_snapshot);
+}
+
+template <typename T>
+std::shared_ptr<const T>
+token_database::snapshot::get_object(const typename __internal::object_traits<T>::key_type& key) const {
+    using namespace __internal;
+    using traits = object_traits<T>;
+
+    // shared cache is skipped, it's refreshed with the changes of popped savepoints before they're
+    // written and may be newer than the snapshot, which would be inconsistent with the iterating reads
+    auto        dbkey = traits::db_key(key);
+    std::string value;
+    auto        status = _token_db.db_->Get(_read_opts, _token_db.handles_[traits::cf], dbkey.as_slice(), &value);
+    if(!status.ok()) {
+        return nullptr;
+    }
+    return std::make_shared<const T>(read_value<T>(value));
+}
+
+int
+token_database::snapshot::exists_domain(const domain_name& name) const {
+    return get_object<domain_def>(name) != nullptr;
+}
+
+int
+token_database::snapshot::read_domain(const domain_name& name, const read_domain_func& func) const {
+    auto v = get_object<domain_def>(name);
+    if(v == nullptr) {
+        __internal::object_traits<domain_def>::throw_not_found(name);
+    }
+    func(*v);
+    return 0;
+}
+
+int
+token_database::snapshot::read_token(const domain_name& domain, const token_name& name, const read_token_func& func) const {
+    auto key = std::make_pair(domain, name);
+    auto v   = get_object<token_def>(key);
+    if(v == nullptr) {
+        __internal::object_traits<token_def>::throw_not_found(key);
+    }
+    func(*v);
+    return 0;
+}
+
+int
+token_database::snapshot::read_group(const group_name& id, const read_group_func& func) const {
+    auto v = get_object<group_def>(id);
+    if(v == nullptr) {
+        __internal::object_traits<group_def>::throw_not_found(id);
+    }
+    func(*v);
+    return 0;
+}
+
+int
+token_database::snapshot::read_account(const account_name& name, const read_account_func& func) const {
+    auto v = get_object<account_def>(name);
+    if(v == nullptr) {
+        __internal::object_traits<account_def>::throw_not_found(name);
+    }
+    func(*v);
+    return 0;
+}
+
+int
+token_database::snapshot::read_domains(const optional<domain_name>& start, const read_domains_func& func) const {
+    _token_db.read_objects<domain_def>(_read_opts, false, __internal::get_domains_range(start), func);
+    return 0;
+}
+
+int
+token_database::snapshot::read_tokens(const domain_name& domain, const optional<token_name>& start, const read_tokens_func& func) const {
+    _token_db.read_objects<token_def>(_read_opts, false, __internal::get_tokens_range(domain, start), func);
+    return 0;
+}
+
+int
+token_database::snapshot::read_groups(const optional<group_name>& start, const read_groups_func& func) const {
+    _token_db.read_objects<group_def>(_read_opts, false, __internal::get_groups_range(start), func);
+    return 0;
+}
+
 }}  // namespace evt::chain
@@ -4,6 +4,7 @@
 //#include <fc/io/sstream.hpp>
 #include <fc/log/logger.hpp>
 //#include <utfcpp/utf8.h>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -12,10 +13,113 @@
 
 namespace fc
 {
+    namespace detail
+    {
+       const uint64_t ones = 0x0101010101010101ull;
+       const uint64_t highs = 0x8080808080808080ull;
+
+       // test 8 bytes at a time, `has_less` is only valid for n <= 128
+       inline bool has_zero( uint64_t v ) { return ((v - ones) & ~v & highs) != 0; }
+       inline bool has_byte( uint64_t v, uint8_t b ) { return has_zero( v ^ (ones * b) ); }
+       inline bool has_less( uint64_t v, uint8_t n ) { return ((v - ones * n) & ~v & highs) != 0; }
+
+       inline uint64_t load8( const char* p )
+       {
+          uint64_t v;
+          memcpy( &v, p, sizeof(v) );
+          return v;
+       }
+    }
+
+    /**
+     *  Input of the parsers which reads the string in place, it has the same peek / get / eof
+     *  semantics of std::istream, but without copying the input or calling into a streambuf.
+     */
+    class string_reader
+    {
+       public:
+          string_reader( const std::string& str )
+          :_pos(str.data()),_end(str.data() + str.size()),_eof(false){}
+
+          int peek()
+          {
+             if( _pos == _end ) { _eof = true; return EOF; }
+             return (unsigned char)*_pos;
+          }
+          int get()
+          {
+             if( _pos == _end ) { _eof = true; return EOF; }
+             return (unsigned char)*_pos++;
+          }
+          bool eof()const { return _eof; }
+
+          /** length of the run from current position which has no '"', '\\' or ^D */
+          size_t plain_run()const
+          {
+             auto p = _pos;
+             while( _end - p >= 8 )
+             {
+                auto v = detail::load8( p );
+                if( detail::has_byte( v, '"' ) || detail::has_byte( v, '\\' ) || detail::has_byte( v, 0x04 ) )
+                   break;
+                p += 8;
+             }
+             while( p != _end && *p != '"' && *p != '\\' && *p != 0x04 )
+                ++p;
+             return p - _pos;
+          }
+          const char* pos()const { return _pos; }
+          void skip( size_t n ) { _pos += n; }
+
+       private:
+          const char* _pos;
+          const char* _end;
+          bool        _eof;
+    };
+
+    /**
+     *  Output of the generators which appends into a string, so the output can be
+     *  built in a buffer reused across calls rather than a new std::stringstream.
+     */
+    class string_writer
+    {
+       public:
+          string_writer( std::string& out ):_out(out){}
+
+          string_writer& operator<<( char c ) { _out.push_back( c ); return *this; }
+          string_writer& operator<<( const char* s ) { _out.append( s ); return *this; }
+          string_writer& operator<<( const std::string& s ) { _out.append( s ); return *this; }
+          string_writer& operator<<( int64_t i )
+          {
+             if( i < 0 )
+             {
+                _out.push_back( '-' );
+                return write_uint( 0 - (uint64_t)i );
+             }
+             return write_uint( i );
+          }
+          string_writer& operator<<( uint64_t i ) { return write_uint( i ); }
+
+          void write( const char* p, size_t n ) { _out.append( p, n ); }
+
+       private:
+          string_writer& write_uint( uint64_t i )
+          {
+             char buf[20];
+             auto p = buf + sizeof(buf);
+             do { *--p = '0' + i % 10; i /= 10; } while( i );
+             _out.append( p, buf + sizeof(buf) - p );
+             return *this;
+          }
+
+          std::string& _out;
+    };
+
     // forward declarations of provided functions
     template<typename T, json::parse_type parser_type> variant variant_from_stream( T& in, uint32_t max_depth );
     template<typename T> char parseEscape( T& in );
     template<typename T> std::string stringFromStream( T& in );
+    std::string stringFromStream( string_reader& in );
     template<typename T> bool skip_white_space( T& in );
     template<typename T> std::string stringFromToken( T& in );
     template<typename T, json::parse_type parser_type> variant_object objectFromStream( T& in, uint32_t max_depth );
@@ -23,6 +127,7 @@ namespace fc
     template<typename T, json::parse_type parser_type> variant number_from_stream( T& in );
     template<typename T> variant token_from_stream( T& in );
     void escape_string( const std::string& str, std::ostream& os );
+    void escape_string( const std::string& str, string_writer& os );
     template<typename T> void to_stream( T& os, const variants& a, json::output_formatting format );
     template<typename T> void to_stream( T& os, const variant_object& o, json::output_formatting format );
     template<typename T> void to_stream( T& os, const variant& v, json::output_formatting format );
@@ -89,7 +194,7 @@ namespace fc
    template<typename T>
    std::string stringFromStream( T& in )
    {
-      std::stringstream token;
+      std::string token;
       try
       {
          char c = in.peek();
@@ -104,28 +209,64 @@ namespace fc
             switch( c = in.peek() )
             {
                case '\\':
-                  token << parseEscape( in );
+                  token += parseEscape( in );
                   break;
                case 0x04:
                   FC_THROW_EXCEPTION( parse_error_exception, "EOF before closing '\"' in string '${token}'",
-                                                   ("token", token.str() ) );
+                                                   ("token", token ) );
                case '"':
                   in.get();
-                  return token.str();
+                  return token;
                default:
-                  token << c;
+                  token += c;
                   in.get();
             }
          }
          FC_THROW_EXCEPTION( parse_error_exception, "EOF before closing '\"' in string '${token}'",
-                                          ("token", token.str() ) );
+                                          ("token", token ) );
        } FC_RETHROW_EXCEPTIONS( warn, "while parsing token '${token}'",
-                                          ("token", token.str() ) );
+                                          ("token", token ) );
    }
+
+   std::string stringFromStream( string_reader& in )
+   {
+      std::string token;
+      try
+      {
+         char c = in.peek();
+
+         if( c != '"' )
+            FC_THROW_EXCEPTION( parse_error_exception,
+                                            "Expected '\"' but read '${char}'",
+                                            ("char", string(&c, (&c) + 1) ) );
+         in.get();
+         while( true )
+         {
+            // plain characters are copied in runs, only escapes and the end are handled one by one
+            auto n = in.plain_run();
+            token.append( in.pos(), n );
+            in.skip( n );
+            switch( in.peek() )
+            {
+               case '\\':
+                  token += parseEscape( in );
+                  break;
+               case '"':
+                  in.get();
+                  return token;
+               default:
+                  FC_THROW_EXCEPTION( parse_error_exception, "EOF before closing '\"' in string '${token}'",
+                                                   ("token", token ) );
+            }
+         }
+       } FC_RETHROW_EXCEPTIONS( warn, "while parsing token '${token}'",
+                                          ("token", token ) );
+   }
+
    template<typename T>
    std::string stringFromToken( T& in )
    {
-      std::stringstream token;
+      std::string token;
       try
       {
          char c = in.peek();
@@ -135,37 +276,37 @@ namespace fc
             switch( c = in.peek() )
             {
                case '\\':
-                  token << parseEscape( in );
+                  token += parseEscape( in );
                   break;
                case '\t':
                case ' ':
                case '\n':
                   in.get();
-                  return token.str();
+                  return token;
                case '\0':
                   FC_THROW_EXCEPTION( eof_exception, "unexpected end of file" );
                default:
                 if( isalnum( c ) || c == '_' || c == '-' || c == '.' || c == ':' || c == '/' )
                 {
-                  token << c;
+                  token += c;
                   in.get();
                 }
-                else return token.str();
+                else return token;
             }
          }
-         return token.str();
+         return token;
       }
       catch( const fc::eof_exception& eof )
       {
-         return token.str();
+         return token;
       }
       catch (const std::ios_base::failure&)
       {
-         return token.str();
+         return token;
       }
 
       FC_RETHROW_EXCEPTIONS( warn, "while parsing token '${token}'",
-                                          ("token", token.str() ) );
+                                          ("token", token ) );
    }
 
    template<typename T, json::parse_type parser_type>
@@ -253,14 +394,14 @@ namespace fc
    template<typename T, json::parse_type parser_type>
    variant number_from_stream( T& in )
    {
-      std::stringstream ss;
+      std::string str;
 
       bool  dot = false;
       bool  neg = false;
       if( in.peek() == '-')
       {
         neg = true;
-        ss.put( in.get() );
+        str += char( in.get() );
       }
       bool done = false;
 
@@ -285,14 +426,14 @@ namespace fc
               case '7':
               case '8':
               case '9':
-                 ss.put( in.get() );
+                 str += char( in.get() );
                  break;
               case '\0':
                  FC_THROW_EXCEPTION( eof_exception, "unexpected end of file" );
               default:
                  if( isalnum( c ) )
                  {
-                    return ss.str() + stringFromToken( in );
+                    return str + stringFromToken( in );
                  }
                 done = true;
                 break;
@@ -305,7 +446,6 @@ namespace fc
       catch (const std::ios_base::failure&)
       {
       }
-      std::string str = ss.str();
       if (str == "-." || str == "." || str == "-") // check the obviously wrong things we could have encountered
         FC_THROW_EXCEPTION(parse_error_exception, "Can't parse token \"${token}\" as a JSON numeric constant", ("token", str));
       if( dot )
@@ -317,8 +457,7 @@ namespace fc
    template<typename T>
    variant token_from_stream( T& in )
    {
-      std::stringstream ss;
-      ss.exceptions( std::ifstream::badbit );
+      std::string str;
       bool received_eof = false;
       bool done = false;
 
@@ -338,7 +477,7 @@ namespace fc
               case 'f':
               case 'a':
               case 's':
-                 ss.put( in.get() );
+                 str += char( in.get() );
                  break;
               default:
                  done = true;
@@ -357,7 +496,6 @@ namespace fc
 
       // we can get here either by processing a delimiter as in "null,"
       // an EOF like "null<EOF>", or an invalid token like "nullZ"
-      std::string str = ss.str();
       if( str == "null" )
         return variant();
       if( str == "true" )
@@ -442,18 +580,18 @@ namespace fc
 
    variant json::from_string( const std::string& utf8_str, parse_type ptype, uint32_t max_depth )
    { try {
-      std::stringstream in( utf8_str );
+      string_reader in( utf8_str );
       //in.exceptions( std::ifstream::eofbit );
       switch( ptype )
       {
           case legacy_parser:
-             return variant_from_stream<std::stringstream, legacy_parser>( in, max_depth );
+             return variant_from_stream<string_reader, legacy_parser>( in, max_depth );
           case legacy_parser_with_string_doubles:
-              return variant_from_stream<std::stringstream, legacy_parser_with_string_doubles>( in, max_depth );
+              return variant_from_stream<string_reader, legacy_parser_with_string_doubles>( in, max_depth );
           case strict_parser:
-              return json_relaxed::variant_from_stream<std::stringstream, true>( in, max_depth );
+              return json_relaxed::variant_from_stream<string_reader, true>( in, max_depth );
           case relaxed_parser:
-              return json_relaxed::variant_from_stream<std::stringstream, false>( in, max_depth );
+              return json_relaxed::variant_from_stream<string_reader, false>( in, max_depth );
           default:
               FC_ASSERT( false, "Unknown JSON parser type {ptype}", ("ptype", ptype) );
       }
@@ -462,13 +600,13 @@ namespace fc
    variants json::variants_from_string( const std::string& utf8_str, parse_type ptype, uint32_t max_depth )
    { try {
       variants result;
-      std::stringstream in( utf8_str );
+      string_reader in( utf8_str );
       //in.exceptions( std::ifstream::eofbit );
       try {
          while( true )
          {
            // result.push_back( variant_from_stream( in ));
-           result.push_back(json_relaxed::variant_from_stream<std::stringstream, false>( in, max_depth ));
+           result.push_back(json_relaxed::variant_from_stream<string_reader, false>( in, max_depth ));
          }
       } catch ( const fc::eof_exception& ){}
       return result;
@@ -560,6 +698,48 @@ namespace fc
       }
       os << '"';
    }
+   void escape_string( const string& str, string_writer& os )
+   {
+      static const char* hex = "0123456789abcdef";
+
+      os << '"';
+      auto p = str.data();
+      auto end = p + str.size();
+      while( p != end )
+      {
+         // characters which need no escaping are copied in runs, 8 bytes are tested at a time
+         auto q = p;
+         while( end - q >= 8 )
+         {
+            auto v = detail::load8( q );
+            if( detail::has_less( v, 0x20 ) || detail::has_byte( v, '"' ) || detail::has_byte( v, '\\' ) )
+               break;
+            q += 8;
+         }
+         while( q != end && (unsigned char)*q >= 0x20 && *q != '"' && *q != '\\' )
+            ++q;
+         os.write( p, q - p );
+         if( q == end )
+            break;
+
+         // same escapes as the std::ostream version above
+         switch( *q )
+         {
+            case '\b': os << "\\b"; break;
+            case '\f': os << "\\f"; break;
+            case '\n': os << "\\n"; break;
+            case '\r': os << "\\r"; break;
+            case '\t': os << "\\t"; break;
+            case '\\': os << "\\\\"; break;
+            case '\"': os << "\\\""; break;
+            default:
+               os << "\\u00" << hex[(*q >> 4) & 0x0f] << hex[*q & 0x0f];
+         }
+         p = q + 1;
+      }
+      os << '"';
+   }
+
    std::ostream& json::to_stream( std::ostream& out, const std::string& str )
    {
         escape_string( str, out );
@@ -663,15 +843,27 @@ namespace fc
 
    std::string   json::to_string( const variant& v, output_formatting format )
    {
-      std::stringstream ss;
-      fc::to_stream( ss, v, format );
-      return ss.str();
+      // each thread reuses one buffer, it grows to fit the largest outputs instead of growing from empty
+      // for every call, and it's released when it gets too large to keep.
+      const size_t max_kept_buffer_size = 4 * 1024 * 1024;
+      static thread_local std::string buffer;
+
+      buffer.clear();
+      string_writer out( buffer );
+      fc::to_stream( out, v, format );
+
+      auto result = buffer;
+      if( buffer.capacity() > max_kept_buffer_size )
+         std::string().swap( buffer );
+      return result;
    }
 
 
     std::string pretty_print( const std::string& v, uint8_t indent ) {
       int level = 0;
-      std::stringstream ss;
+      std::string out;
+      out.reserve( v.size() * 2 );
+      string_writer ss( out );
       bool first = false;
       bool quote = false;
       bool escape = false;
@@ -754,7 +946,7 @@ namespace fc
               ss << v[i];
          }
       }
-      return ss.str();
+      return out;
     }
 
 
@@ -836,20 +1028,20 @@ namespace fc
    bool json::is_valid( const std::string& utf8_str, parse_type ptype, uint32_t max_depth )
    {
       if( utf8_str.size() == 0 ) return false;
-      std::stringstream in( utf8_str );
+      string_reader in( utf8_str );
       switch( ptype )
       {
           case legacy_parser:
-             variant_from_stream<std::stringstream, legacy_parser>( in, max_depth );
+             variant_from_stream<string_reader, legacy_parser>( in, max_depth );
               break;
           case legacy_parser_with_string_doubles:
-             variant_from_stream<std::stringstream, legacy_parser_with_string_doubles>( in, max_depth );
+             variant_from_stream<string_reader, legacy_parser_with_string_doubles>( in, max_depth );
               break;
           case strict_parser:
-             json_relaxed::variant_from_stream<std::stringstream, true>( in, max_depth );
+             json_relaxed::variant_from_stream<string_reader, true>( in, max_depth );
               break;
           case relaxed_parser:
-             json_relaxed::variant_from_stream<std::stringstream, false>( in, max_depth );
+             json_relaxed::variant_from_stream<string_reader, false>( in, max_depth );
               break;
           default:
               FC_ASSERT( false, "Unknown JSON parser type {ptype}", ("ptype", ptype) );
@@ -88,19 +88,90 @@ chain_api_plugin::plugin_startup() {
     auto ro_api = app().get_plugin<chain_plugin>().get_read_only_api();
     auto rw_api = app().get_plugin<chain_plugin>().get_read_write_api();
 
+    // calls which only read block log or system abi are served on http threads
+    app().get_plugin<http_plugin>().add_concurrent_api({CHAIN_RO_CALL(abi_json_to_bin, 200),
+                                                        CHAIN_RO_CALL(abi_bin_to_json, 200),
+                                                        CHAIN_RO_CALL(trx_json_to_digest, 200)});
+
+    // irreversible blocks are read from block log on http threads, others are in fork database owned by main thread
+    app().get_plugin<http_plugin>().add_concurrent_handler("/v1/chain/get_block", [ro_api](string, string body, url_response_callback cb) {
+        try {
+            if(body.empty())
+                body = "{}";
+            auto params = fc::json::from_string(body).as<chain_apis::read_only::get_block_params>();
+            auto result = ro_api.get_irreversible_block(params);
+            if(!result.is_null()) {
+                cb(200, fc::json::to_string(result));
+                return;
+            }
+            app().get_io_service().post([ro_api, params, body, cb] {
+                try {
+                    cb(200, fc::json::to_string(ro_api.get_block(params)));
+                }
+                catch(...) {
+                    http_plugin::handle_exception("chain", "get_block", body, cb);
+                }
+            });
+        }
+        catch(...) {
+            http_plugin::handle_exception("chain", "get_block", body, cb);
+        }
+    });
+
     app().get_plugin<http_plugin>().add_api({CHAIN_RO_CALL(get_info, 200),
-                                             CHAIN_RO_CALL(get_block, 200),
                                              CHAIN_RO_CALL(get_block_header_state, 200),
-                                             CHAIN_RO_CALL(abi_json_to_bin, 200),
-                                             CHAIN_RO_CALL(abi_bin_to_json, 200),
-                                             CHAIN_RO_CALL(trx_json_to_digest, 200),
                                              CHAIN_RO_CALL(get_required_keys, 200),
-                                             CHAIN_RW_CALL_ASYNC(push_block, chain_apis::read_write::push_block_results, 202),
-                                             CHAIN_RW_CALL_ASYNC(push_transaction, chain_apis::read_write::push_transaction_results, 202),
-                                             CHAIN_RW_CALL_ASYNC(push_transactions, chain_apis::read_write::push_transactions_results, 202)});
+                                             CHAIN_RW_CALL_ASYNC(push_block, chain_apis::read_write::push_block_results, 202)});
+
+    // transactions are decoded from and traces are encoded into JSON text directly
+    app().get_plugin<http_plugin>().add_handler("/v1/chain/push_transaction", [rw_api](string, string body, url_response_callback cb) mutable {
+        if(body.empty())
+            body = "{}";
+        rw_api.push_transaction_json(body, [cb, body](const fc::static_variant<fc::exception_ptr, std::string>& result) {
+            if(result.contains<fc::exception_ptr>()) {
+                try {
+                    result.get<fc::exception_ptr>()->dynamic_rethrow_exception();
+                }
+                catch(...) {
+                    http_plugin::handle_exception("chain", "push_transaction", body, cb);
+                }
+            }
+            else {
+                cb(202, result.get<std::string>());
+            }
+        });
+    });
+
+    // batches are decoded on http threads, then pushed on main thread all at once
+    auto push_batch = [rw_api](auto call, const char* call_name, const char* empty_body) {
+        return [rw_api, call, call_name, empty_body](string, string body, url_response_callback cb) mutable {
+            if(body.empty())
+                body = empty_body;
+            (rw_api.*call)(body, [cb, body, call_name](const fc::static_variant<fc::exception_ptr, std::string>& result) {
+                if(result.contains<fc::exception_ptr>()) {
+                    try {
+                        result.get<fc::exception_ptr>()->dynamic_rethrow_exception();
+                    }
+                    catch(...) {
+                        http_plugin::handle_exception("chain", call_name, body, cb);
+                    }
+                }
+                else {
+                    cb(202, result.get<std::string>());
+                }
+            });
+        };
+    };
+    app().get_plugin<http_plugin>().add_concurrent_handler("/v1/chain/push_transactions",
+        push_batch(&chain_apis::read_write::push_transactions_json, "push_transactions", "[]"));
+    app().get_plugin<http_plugin>().add_concurrent_handler("/v1/chain/push_transactions_binary",
+        push_batch(&chain_apis::read_write::push_transactions_binary, "push_transactions_binary", ""));
 }
 
 void
-chain_api_plugin::plugin_shutdown() {}
+chain_api_plugin::plugin_shutdown() {
+    // concurrent handlers refer to controller owned by chain_plugin
+    app().get_plugin<http_plugin>().stop_http_threads();
+}
 
 }  // namespace evt
@@ -8,15 +8,18 @@
 #include <evt/chain/exceptions.hpp>
 #include <evt/chain/fork_database.hpp>
 #include <evt/chain/reversible_block_object.hpp>
+#include <evt/chain/token_database.hpp>
 #include <evt/chain/types.hpp>
 #include <evt/chain/genesis_state.hpp>
 #include <evt/chain/contracts/evt_contract.hpp>
 
 #include <evt/utilities/key_conversion.hpp>
 
+#include <boost/asio/steady_timer.hpp>
 #include <boost/signals2/connection.hpp>
 
 #include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
 #include <fc/variant.hpp>
 #include <signal.h>
 
@@ -78,6 +81,25 @@ public:
     int32_t                          max_reversible_block_time_ms;
     int32_t                          max_pending_transaction_time_ms;
 
+    // flushes the tail of block log when no more blocks are appended
+    uint32_t                              blog_flush_interval_ms = 0;
+    unique_ptr<boost::asio::steady_timer> blog_flush_timer;
+
+    void
+    start_blog_flush_timer() {
+        blog_flush_timer->expires_from_now(std::chrono::milliseconds(blog_flush_interval_ms));
+        blog_flush_timer->async_wait([this](const boost::system::error_code& ec) {
+            if(ec == boost::asio::error::operation_aborted || !chain) {
+                return;
+            }
+            try {
+                chain->flush_block_log();
+            }
+            FC_LOG_AND_DROP();
+            start_blog_flush_timer();
+        });
+    }
+
     // retained references to channels for easy publication
     channels::accepted_block_header::channel_type& accepted_block_header_channel;
     channels::accepted_block::channel_type&        accepted_block_channel;
@@ -116,10 +138,16 @@ void
 chain_plugin::set_program_options(options_description& cli, options_description& cfg) {
     cfg.add_options()
         ("blocks-dir", bpo::value<bfs::path>()->default_value("blocks"), "the location of the blocks directory (absolute path or relative to application data dir)")
+        ("blocks-archive-dir", bpo::value<bfs::path>()->default_value(config::default_blocks_archive_dir_name), "the location of the compressed segments of old blocks (absolute path or relative to application data dir), segments can be removed or moved to other place")
+        ("blocks-archive-segment-size", bpo::value<uint32_t>()->default_value(config::default_blocks_archive_segment_size), "Number of blocks in each segment of the blocks archive")
         ("tokendb-dir", bpo::value<bfs::path>()->default_value("tokendb"), "the location of the token database directory (absolute path or relative to application data dir)")
+        ("tokendb-cache-size", bpo::value<uint64_t>()->default_value(config::default_tokendb_cache_size), "Maximum number of cached objects of each type in the token database, 0 to disable the cache")
         ("checkpoint", bpo::value<vector<string>>()->composing(), "Pairs of [BLOCK_NUM,BLOCK_ID] that should be enforced as checkpoints.")
         ("chain-state-db-size-mb", bpo::value<uint64_t>()->default_value(config::default_state_size / (1024 * 1024)), "Maximum size (in MB) of the chain state database")
         ("reversible-blocks-db-size-mb", bpo::value<uint64_t>()->default_value(config::default_reversible_cache_size / (1024 * 1024)), "Maximum size (in MB) of the reversible blocks database")
+        ("chain-threads", bpo::value<uint16_t>()->default_value(config::default_controller_thread_pool_size), "Number of worker threads in controller thread pool, used to recover signatures, 0 to do them on main thread")
+        ("block-log-flush-blocks", bpo::value<uint32_t>()->default_value(config::default_block_log_flush_interval_blocks), "Flush the block log after this number of irreversible blocks are appended")
+        ("block-log-flush-interval-ms", bpo::value<uint32_t>()->default_value(config::default_block_log_flush_interval_ms), "Flush the block log when this number of milliseconds has passed since last flush")
         ("contracts-console", bpo::bool_switch()->default_value(false), "print contract's output to console");
 
     cli.add_options()
@@ -132,7 +160,9 @@ chain_plugin::set_program_options(options_description& cli, options_description&
         ("replay-blockchain", bpo::bool_switch()->default_value(false), "clear chain state database and token database and replay all blocks")
         ("hard-replay-blockchain", bpo::bool_switch()->default_value(false), "clear chain state database and token database, recover as many blocks as possible from the block log, and then replay those blocks")
         ("delete-all-blocks", bpo::bool_switch()->default_value(false), "clear chain state database, token database and block log")
+        ("archive-blocks", bpo::bool_switch()->default_value(false), "move full segments of old irreversible blocks from block log into blocks archive on startup")
         ("truncate-at-block", bpo::value<uint32_t>()->default_value(0), "stop hard replay / block log recovery at this block number (if set to non-zero number)")
+        ("upgrade-tokendb", bpo::bool_switch()->default_value(false), "convert token database of legacy layout into column family layout, the old one is kept as backup")
         ;
 }
 
@@ -181,6 +211,14 @@ chain_plugin::plugin_initialize(const variables_map& options) {
             my->blocks_dir = bld;
     }
 
+    if(options.count("blocks-archive-dir")) {
+        auto bld = options.at("blocks-archive-dir").as<bfs::path>();
+        if(bld.is_relative())
+            my->chain_config->blocks_archive_dir = app().data_dir() / bld;
+        else
+            my->chain_config->blocks_archive_dir = bld;
+    }
+
     if(options.count("tokendb-dir")) {
         auto bld = options.at("tokendb-dir").as<bfs::path>();
         if(bld.is_relative())
@@ -202,12 +240,25 @@ chain_plugin::plugin_initialize(const variables_map& options) {
     my->chain_config->state_dir  = app().data_dir() / config::default_state_dir_name;
     my->chain_config->read_only  = my->readonly;
 
+    if(options.count("tokendb-cache-size"))
+        my->chain_config->tokendb_cache_size = options.at("tokendb-cache-size").as<uint64_t>();
+
     if(options.count("chain-state-db-size-mb"))
         my->chain_config->state_size = options.at("chain-state-db-size-mb").as<uint64_t>() * 1024 * 1024;
 
     if(options.count("reversible-blocks-db-size-mb"))
         my->chain_config->reversible_cache_size = options.at("reversible-blocks-db-size-mb").as<uint64_t>() * 1024 * 1024;
 
+    if(options.count("chain-threads"))
+        my->chain_config->thread_pool_size = options.at("chain-threads").as<uint16_t>();
+
+    if(options.count("block-log-flush-blocks"))
+        my->chain_config->blog_flush_interval_blocks = options.at("block-log-flush-blocks").as<uint32_t>();
+
+    if(options.count("block-log-flush-interval-ms"))
+        my->chain_config->blog_flush_interval_ms = options.at("block-log-flush-interval-ms").as<uint32_t>();
+    my->blog_flush_interval_ms = my->chain_config->blog_flush_interval_ms;
+
     my->chain_config->force_all_checks  = options.at("force-all-checks").as<bool>();
     my->chain_config->contracts_console = options.at("contracts-console").as<bool>();
 
@@ -247,6 +298,7 @@ chain_plugin::plugin_initialize(const variables_map& options) {
         fc::remove_all(my->chain_config->state_dir);
         fc::remove_all(my->chain_config->tokendb_dir);
         fc::remove_all(my->blocks_dir);
+        fc::remove_all(my->chain_config->blocks_archive_dir);
     }
     else if(options.at("hard-replay-blockchain").as<bool>()) {
         ilog("Hard replay requested: deleting state database and token database");
@@ -296,6 +348,25 @@ chain_plugin::plugin_initialize(const variables_map& options) {
         wlog("The --truncate-at-block option can only be used with --fix-reversible-blocks without a replay or with --hard-replay-blockchain.");
     }
 
+    if(options.at("upgrade-tokendb").as<bool>()) {
+        if(fc::exists(my->chain_config->tokendb_dir)) {
+            token_database::upgrade_layout(my->chain_config->tokendb_dir);
+        }
+        else {
+            wlog("The --upgrade-tokendb option is ignored because token database doesn't exist.");
+        }
+    }
+
+    if(options.at("archive-blocks").as<bool>()) {
+        if(fc::exists(my->blocks_dir / "blocks.log")) {
+            block_log::archive_log(my->blocks_dir, my->chain_config->blocks_archive_dir,
+                                   options.at("blocks-archive-segment-size").as<uint32_t>());
+        }
+        else {
+            wlog("The --archive-blocks option is ignored because block log doesn't exist.");
+        }
+    }
+
     if(options.count("genesis-json")) {
         FC_ASSERT(!fc::exists(my->blocks_dir / "blocks.log"), "Genesis state can only be set on a fresh blockchain.");
 
@@ -389,6 +460,12 @@ chain_plugin::plugin_startup() {
         ilog("Blockchain started; head block is #${num}, genesis timestamp is ${ts}",
              ("num", my->chain->head_block_num())("ts", (std::string)my->chain_config->genesis.initial_timestamp));
 
+        // blocks are flushed on append when there's no interval
+        if(my->blog_flush_interval_ms > 0) {
+            my->blog_flush_timer = std::make_unique<boost::asio::steady_timer>(app().get_io_service());
+            my->start_blog_flush_timer();
+        }
+
         my->chain_config.reset();
     }
     FC_CAPTURE_AND_RETHROW()
@@ -396,6 +473,9 @@ chain_plugin::plugin_startup() {
 
 void
 chain_plugin::plugin_shutdown() {
+    if(my->blog_flush_timer) {
+        my->blog_flush_timer->cancel();
+    }
     my->accepted_block_header_connection.reset();
     my->accepted_block_connection.reset();
     my->irreversible_block_connection.reset();
@@ -582,7 +662,7 @@ read_only::get_info(const read_only::get_info_params&) const {
 template <typename Api>
 auto
 make_resolver(const Api* api) {
-    return [api] {
+    return [api]() -> const abi_serializer& {
         return api->system_api;
     };
 }
@@ -600,12 +680,46 @@ read_only::get_block(const read_only::get_block_params& params) const {
 
     EVT_ASSERT(block, unknown_block_exception, "Could not find block: ${block}", ("block", params.block_num_or_id));
 
+    return block_to_variant(*block);
+}
+
+fc::variant
+read_only::get_irreversible_block(const read_only::get_block_params& params) const {
+    signed_block_ptr   block;
+    optional<uint64_t> block_num;
+    try {
+        block_num = fc::to_uint64(params.block_num_or_id);
+    }
+    catch(...) {}
+
+    if(block_num.valid()) {
+        block = db.fetch_irreversible_block_by_number(*block_num);
+    }
+    else {
+        try {
+            auto id = fc::json::from_string(params.block_num_or_id).as<block_id_type>();
+            block   = db.fetch_irreversible_block_by_number(block_header::num_from_id(id));
+            if(block && block->id() != id) {
+                block = nullptr;
+            }
+        }
+        EVT_RETHROW_EXCEPTIONS(chain::block_id_type_exception, "Invalid block ID: ${block_num_or_id}", ("block_num_or_id", params.block_num_or_id))
+    }
+
+    if(!block) {
+        return fc::variant();
+    }
+    return block_to_variant(*block);
+}
+
+fc::variant
+read_only::block_to_variant(const signed_block& block) const {
     fc::variant pretty_output;
-    abi_serializer::to_variant(*block, pretty_output, make_resolver(this));
+    abi_serializer::to_variant(block, pretty_output, make_resolver(this));
 
-    uint32_t ref_block_prefix = block->id()._hash[1];
+    uint32_t ref_block_prefix = block.id()._hash[1];
 
-    return fc::mutable_variant_object(pretty_output.get_object())("id", block->id())("block_num", block->block_num())("ref_block_prefix", ref_block_prefix);
+    return fc::mutable_variant_object(pretty_output.get_object())("id", block.id())("block_num", block.block_num())("ref_block_prefix", ref_block_prefix);
 }
 
 fc::variant read_only::get_block_header_state(const get_block_header_state_params& params) const {
@@ -681,39 +795,196 @@ read_write::push_transaction(const read_write::push_transaction_params& params,
     CATCH_AND_CALL(next);
 }
 
-static void
-push_recurse(read_write* rw, int index, const std::shared_ptr<read_write::push_transactions_params>& params, const std::shared_ptr<read_write::push_transactions_results>& results, const next_function<read_write::push_transactions_results>& next) {
-    auto wrapped_next = [=](const fc::static_variant<fc::exception_ptr, read_write::push_transaction_results>& result) {
-        if(result.contains<fc::exception_ptr>()) {
-            const auto& e = result.get<fc::exception_ptr>();
-            results->emplace_back(read_write::push_transaction_results{transaction_id_type(), fc::mutable_variant_object("error", e->to_detail_string())});
+void
+read_write::push_transaction_json(const string& body, next_function<string> next) {
+    try {
+        auto pretty_input = std::make_shared<packed_transaction>();
+        auto resolver     = make_resolver(this);
+        try {
+            abi_serializer::from_json(body, *pretty_input, resolver);
         }
-        else {
-            const auto& r = result.get<read_write::push_transaction_results>();
-            results->emplace_back(r);
+        EVT_RETHROW_EXCEPTIONS(chain::packed_transaction_type_exception, "Invalid packed transaction")
+
+        app().get_method<incoming::methods::transaction_async>()(pretty_input, true, [this, next](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& result) -> void {
+            if(result.contains<fc::exception_ptr>()) {
+                next(result.get<fc::exception_ptr>());
+            }
+            else {
+                auto trx_trace_ptr = result.get<transaction_trace_ptr>();
+
+                try {
+                    // same text as push_transaction_results
+                    auto json = string("{\"transaction_id\":");
+                    json += fc::json::to_string(trx_trace_ptr->id);
+                    json += ",\"processed\":";
+                    abi_serializer::to_json(*trx_trace_ptr, json, make_resolver(this));
+                    json += '}';
+
+                    next(std::move(json));
+                }
+                CATCH_AND_CALL(next);
+            }
+        });
+    }
+    catch(boost::interprocess::bad_alloc&) {
+        raise(SIGUSR1);
+    }
+    CATCH_AND_CALL(next);
+}
+
+constexpr uint32_t def_max_push_transactions = 10000;
+
+namespace __internal {
+
+// each transaction of a batch is either decoded or failed
+using push_item = fc::static_variant<fc::exception_ptr, packed_transaction_ptr>;
+
+/**
+ * Results of the transactions pushed by one batch, they're filled in any order as the transactions
+ * are done and replied together in the order of request. Only accessed on main thread.
+ */
+struct push_batch {
+    push_batch(size_t size, next_function<string> next)
+        : results(size)
+        , remaining(size)
+        , next(std::move(next)) {}
+
+    void
+    set_result(size_t i, string&& json) {
+        results[i] = std::move(json);
+        if(--remaining > 0) {
+            return;
         }
 
-        int next_index = index + 1;
-        if(next_index < params->size()) {
-            push_recurse(rw, next_index, params, results, next);
+        auto out = string("[");
+        for(auto& r : results) {
+            if(out.size() > 1) {
+                out += ',';
+            }
+            out += r;
         }
-        else {
-            next(*results);
+        out += ']';
+        next(std::move(out));
+    }
+
+    void
+    set_error(size_t i, const transaction_id_type& id, const fc::exception_ptr& e) {
+        // same as push_transaction_results, with error in place of trace
+        auto json = string("{\"transaction_id\":");
+        json += fc::json::to_string(id);
+        json += ",\"processed\":";
+        json += fc::json::to_string(fc::mutable_variant_object("error", e->to_detail_string()));
+        json += '}';
+        set_result(i, std::move(json));
+    }
+
+    vector<string>        results;
+    size_t                remaining;
+    next_function<string> next;
+};
+
+// decodes transactions one by one in calling thread, failures are kept for each transaction.
+// pushing handlers run on the http thread pool, so concurrent batches are still decoded in parallel.
+// A batch is not split over the thread pool of controller, which recovers keys and prefetches
+// for the blocks being applied
+template <typename Decode>
+vector<push_item>
+decode_transactions(size_t count, Decode&& decode) {
+    auto items = vector<push_item>(count);
+    for(auto i = 0u; i < count; i++) {
+        auto set_error = [&items, i](const fc::exception_ptr& e) { items[i] = e; };
+        try {
+            items[i] = decode(i);
         }
-    };
+        CATCH_AND_CALL(set_error);
+    }
+    return items;
+}
+
+// `rw` is copied as the batch outlives the calls, it only refers to controller and system abi
+void
+push_transactions(const read_write& rw, vector<push_item>&& items, next_function<string> next) {
+    if(items.empty()) {
+        next(string("[]"));
+        return;
+    }
+
+    // all the transactions are handed to producer at once, their signatures are recovered by
+    // the thread pool of controller concurrently and they are applied in the order of request
+    auto batch = std::make_shared<push_batch>(items.size(), std::move(next));
+    app().get_io_service().post([rw, batch, items = std::move(items)] {
+        auto& method = app().get_method<incoming::methods::transaction_async>();
+        for(auto i = 0u; i < items.size(); i++) {
+            if(items[i].contains<fc::exception_ptr>()) {
+                batch->set_error(i, transaction_id_type(), items[i].get<fc::exception_ptr>());
+                continue;
+            }
 
-    rw->push_transaction(params->at(index), wrapped_next);
+            auto trx = items[i].get<packed_transaction_ptr>();
+            method(trx, true, [rw, batch, trx, i](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& result) {
+                auto set_error = [batch, trx, i](const fc::exception_ptr& e) { batch->set_error(i, trx->id(), e); };
+                if(result.contains<fc::exception_ptr>()) {
+                    set_error(result.get<fc::exception_ptr>());
+                    return;
+                }
+                try {
+                    const auto& trace = result.get<transaction_trace_ptr>();
+
+                    auto json = string("{\"transaction_id\":");
+                    json += fc::json::to_string(trace->id);
+                    json += ",\"processed\":";
+                    abi_serializer::to_json(*trace, json, make_resolver(&rw));
+                    json += '}';
+                    batch->set_result(i, std::move(json));
+                }
+                CATCH_AND_CALL(set_error);
+            });
+        }
+    });
 }
 
+}  // namespace __internal
+
 void
-read_write::push_transactions(const read_write::push_transactions_params& params, next_function<read_write::push_transactions_results> next) {
+read_write::push_transactions_json(const string& body, next_function<string> next) {
     try {
-        FC_ASSERT(params.size() <= 1000, "Attempt to push too many transactions at once");
-        auto params_copy = std::make_shared<read_write::push_transactions_params>(params.begin(), params.end());
-        auto result      = std::make_shared<read_write::push_transactions_results>();
-        result->reserve(params.size());
+        auto elements = contracts::impl::json_parse_array(contracts::impl::json_parse(body));
+        FC_ASSERT(elements.size() <= def_max_push_transactions, "Attempt to push too many transactions at once");
+
+        auto items = __internal::decode_transactions(elements.size(), [&](size_t i) {
+            auto trx = std::make_shared<packed_transaction>();
+            try {
+                abi_serializer::from_json(string(elements[i].begin, elements[i].end), *trx, make_resolver(this));
+            }
+            EVT_RETHROW_EXCEPTIONS(chain::packed_transaction_type_exception, "Invalid packed transaction")
+            return trx;
+        });
+        __internal::push_transactions(*this, std::move(items), std::move(next));
+    }
+    CATCH_AND_CALL(next);
+}
 
-        push_recurse(this, 0, params_copy, result, next);
+void
+read_write::push_transactions_binary(const string& body, next_function<string> next) {
+    try {
+        auto items = vector<__internal::push_item>();
+        try {
+            auto ds = fc::datastream<const char*>(body.data(), body.size());
+
+            fc::unsigned_int size;
+            fc::raw::unpack(ds, size);
+            FC_ASSERT(size.value <= def_max_push_transactions, "Attempt to push too many transactions at once");
+
+            // binary is only copied here, transactions are unpacked when producer builds their metadata
+            items.reserve(size.value);
+            for(auto i = 0u; i < size.value; i++) {
+                auto trx = std::make_shared<packed_transaction>();
+                fc::raw::unpack(ds, *trx);
+                items.emplace_back(std::move(trx));
+            }
+        }
+        EVT_RETHROW_EXCEPTIONS(chain::packed_transaction_type_exception, "Invalid packed transactions")
+        __internal::push_transactions(*this, std::move(items), std::move(next));
     }
     CATCH_AND_CALL(next);
 }
@@ -113,11 +113,18 @@ public:
 
     fc::variant get_block(const get_block_params& params) const;
 
+    // only looks up the irreversible blocks in block log, so it can be called from any thread.
+    // returns null when the block is not there, it may be still reversible.
+    fc::variant get_irreversible_block(const get_block_params& params) const;
+
     struct get_block_header_state_params {
         string block_num_or_id;
     };
 
     fc::variant get_block_header_state(const get_block_header_state_params& params) const;
+
+private:
+    fc::variant block_to_variant(const chain::signed_block& block) const;
 };
 
 class read_write {
@@ -141,9 +148,16 @@ public:
     };
     void push_transaction(const push_transaction_params& params, chain::plugin_interface::next_function<push_transaction_results> next);
 
-    using push_transactions_params  = vector<push_transaction_params>;
-    using push_transactions_results = vector<push_transaction_results>;
-    void push_transactions(const push_transactions_params& params, chain::plugin_interface::next_function<push_transactions_results> next);
+    // takes the JSON of push_transaction_params and replies push_transaction_results in JSON,
+    // neither the transaction nor its trace is built as variants
+    void push_transaction_json(const string& body, chain::plugin_interface::next_function<string> next);
+
+    // takes a JSON array of push_transaction_params, or the binary of packed `vector<packed_transaction>`,
+    // replies the JSON array of push_transaction_results in the same order, failed ones have `error` in `processed`.
+    // Transactions of one batch are decoded one by one in calling thread, batches of concurrent requests are decoded
+    // in parallel by the http threads. Decoded transactions are pushed on main thread all at once.
+    void push_transactions_json(const string& body, chain::plugin_interface::next_function<string> next);
+    void push_transactions_binary(const string& body, chain::plugin_interface::next_function<string> next);
 
     friend resolver_factory<read_write>;
 };
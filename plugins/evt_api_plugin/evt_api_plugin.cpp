@@ -55,20 +55,27 @@ evt_api_plugin::plugin_startup() {
     auto ro_api = app().get_plugin<evt_plugin>().get_read_only_api();
     auto rw_api = app().get_plugin<evt_plugin>().get_read_write_api();
 
-    app().get_plugin<http_plugin>().add_api({EVT_RO_CALL(get_domain, 200),
-                                             EVT_RO_CALL(get_group, 200),
-                                             EVT_RO_CALL(get_token, 200),
-                                             EVT_RO_CALL(get_account, 200)
-                                         });
+    app().get_plugin<http_plugin>().add_concurrent_api({EVT_RO_CALL(get_domain, 200),
+                                                        EVT_RO_CALL(get_group, 200),
+                                                        EVT_RO_CALL(get_token, 200),
+                                                        EVT_RO_CALL(get_account, 200),
+                                                        EVT_RO_CALL(get_domains, 200),
+                                                        EVT_RO_CALL(get_tokens, 200),
+                                                        EVT_RO_CALL(get_groups, 200)
+                                                    });
 #ifdef ENABLE_MONGODB
-    app().get_plugin<http_plugin>().add_api({EVT_RO_CALL(get_my_tokens, 200),
-                                             EVT_RO_CALL(get_my_domains, 200),
-                                             EVT_RO_CALL(get_my_groups, 200)
-                                         });
+    app().get_plugin<http_plugin>().add_concurrent_api({EVT_RO_CALL(get_my_tokens, 200),
+                                                        EVT_RO_CALL(get_my_domains, 200),
+                                                        EVT_RO_CALL(get_my_groups, 200),
+                                                        EVT_RO_CALL(get_mongodb_stats, 200)
+                                                    });
 #endif
 }
 
 void
-evt_api_plugin::plugin_shutdown() {}
+evt_api_plugin::plugin_shutdown() {
+    // concurrent handlers refer to evt_plugin and mongo_db_plugin
+    app().get_plugin<http_plugin>().stop_http_threads();
+}
 
 }  // namespace evt
@@ -10,6 +10,7 @@
 #include <fc/container/flat.hpp>
 #include <fc/io/json.hpp>
 #include <fc/variant.hpp>
+#include <fc/variant_object.hpp>
 
 namespace evt {
 
@@ -61,9 +62,9 @@ namespace evt_apis {
 
 fc::variant
 read_only::get_domain(const read_only::get_domain_params& params) {
-    const auto& db = db_.token_db();
-    variant     var;
-    auto        r = db.read_domain(params.name, [&](const auto& d) {
+    auto    db = db_.token_db().new_snapshot();
+    variant var;
+    auto    r  = db->read_domain(params.name, [&](const auto& d) {
         fc::to_variant(d, var);
     });
     FC_ASSERT(r == 0, "Cannot find domain: ${name}", ("name", params.name));
@@ -72,9 +73,9 @@ read_only::get_domain(const read_only::get_domain_params& params) {
 
 fc::variant
 read_only::get_group(const read_only::get_group_params& params) {
-    const auto& db = db_.token_db();
-    variant     var;
-    auto        r = db.read_group(params.name, [&](const auto& g) {
+    auto    db = db_.token_db().new_snapshot();
+    variant var;
+    auto    r  = db->read_group(params.name, [&](const auto& g) {
         fc::to_variant(g, var);
     });
     FC_ASSERT(r == 0, "Cannot find group: ${name}", ("name", params.name));
@@ -83,9 +84,9 @@ read_only::get_group(const read_only::get_group_params& params) {
 
 fc::variant
 read_only::get_token(const read_only::get_token_params& params) {
-    const auto& db = db_.token_db();
-    variant     var;
-    auto        r = db.read_token(params.domain, params.name, [&](const auto& t) {
+    auto    db = db_.token_db().new_snapshot();
+    variant var;
+    auto    r  = db->read_token(params.domain, params.name, [&](const auto& t) {
         fc::to_variant(t, var);
     });
     FC_ASSERT(r == 0, "Cannot find token: ${domain}-${name}", ("domain", params.domain)("name", params.name));
@@ -94,15 +95,85 @@ read_only::get_token(const read_only::get_token_params& params) {
 
 fc::variant
 read_only::get_account(const get_account_params& params) {
-    const auto& db = db_.token_db();
-    variant     var;
-    auto        r = db.read_account(params.name, [&](const auto& a) {
+    auto    db = db_.token_db().new_snapshot();
+    variant var;
+    auto    r  = db->read_account(params.name, [&](const auto& a) {
         fc::to_variant(a, var);
     });
     FC_ASSERT(r == 0, "Cannot find account: ${name}", ("name", params.name));
     return var;
 }
 
+namespace __internal {
+
+const uint32_t kDefaultPageSize = 100;
+const uint32_t kMaxPageSize     = 1000;
+
+uint32_t
+get_page_size(const optional<uint32_t>& limit) {
+    if(!limit.valid()) {
+        return kDefaultPageSize;
+    }
+    FC_ASSERT(*limit > 0 && *limit <= kMaxPageSize, "Limit should be in range (0, ${max}]", ("max", kMaxPageSize));
+    return *limit;
+}
+
+// only one page of objects is converted, `more` is set to the name of last object when there're more left
+template <typename T, typename GetName, typename Read>
+fc::variant
+read_page(const char* field, const optional<uint32_t>& limit, GetName&& get_name, Read&& read) {
+    auto size = get_page_size(limit);
+    auto vars = fc::variants();
+    auto last = name128();
+    auto more = false;
+    read([&](const T& v) {
+        if(vars.size() == size) {
+            more = true;
+            return false;
+        }
+        vars.emplace_back();
+        fc::to_variant(v, vars.back());
+        last = get_name(v);
+        return true;
+    });
+
+    auto result = fc::mutable_variant_object(field, std::move(vars));
+    if(more) {
+        result["more"] = (std::string)last;
+    }
+    return result;
+}
+
+}  // namespace __internal
+
+fc::variant
+read_only::get_domains(const get_domains_params& params) {
+    using namespace __internal;
+    auto db = db_.token_db().new_snapshot();
+    return read_page<domain_def>("domains", params.limit, [](const auto& d) { return d.name; }, [&](const auto& func) {
+        db->read_domains(params.start, func);
+    });
+}
+
+fc::variant
+read_only::get_tokens(const get_tokens_params& params) {
+    using namespace __internal;
+    auto db = db_.token_db().new_snapshot();
+    FC_ASSERT(db->exists_domain(params.domain), "Cannot find domain: ${name}", ("name", params.domain));
+    return read_page<token_def>("tokens", params.limit, [](const auto& t) { return t.name; }, [&](const auto& func) {
+        db->read_tokens(params.domain, params.start, func);
+    });
+}
+
+fc::variant
+read_only::get_groups(const get_groups_params& params) {
+    using namespace __internal;
+    auto db = db_.token_db().new_snapshot();
+    return read_page<group_def>("groups", params.limit, [](const auto& g) { return g.name(); }, [&](const auto& func) {
+        db->read_groups(params.start, func);
+    });
+}
+
 #ifdef ENABLE_MONGODB
 
 namespace __internal {
@@ -161,6 +232,14 @@ read_only::get_my_groups(const get_my_params& params) {
     return result;
 }
 
+mongo_db_stats
+read_only::get_mongodb_stats(const get_mongodb_stats_params& params) {
+    auto mongodb = app().find_plugin<mongo_db_plugin>();
+    EVT_ASSERT(mongodb, missing_plugin_exception, "Cannot find mongodb plugin");
+
+    return mongodb->get_stats();
+}
+
 #endif
 
 }  // namespace evt_apis
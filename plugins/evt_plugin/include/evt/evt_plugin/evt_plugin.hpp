@@ -32,6 +32,11 @@ class evt_plugin;
 
 namespace evt_apis {
 
+// objects are read from token database snapshots, so all the calls are safe to be served on http threads
+// concurrently. Snapshots reflect the state of last irreversible block instead of head block: objects
+// created or updated by the reversible blocks are not visible yet, e.g. a domain created a few blocks ago
+// is reported as not found and a transferred token still shows its former owners until the block holding
+// the change becomes irreversible.
 class read_only {
 public:
     read_only(const controller& db)
@@ -62,6 +67,26 @@ public:
     };
     fc::variant get_account(const get_account_params& params);
 
+    // listing APIs are paged, `more` in the result is the cursor of next page, pass it as `start` to continue
+    struct get_domains_params {
+        optional<domain_name> start;
+        optional<uint32_t>    limit;
+    };
+    fc::variant get_domains(const get_domains_params& params);
+
+    struct get_tokens_params {
+        domain_name          domain;
+        optional<token_name> start;
+        optional<uint32_t>   limit;
+    };
+    fc::variant get_tokens(const get_tokens_params& params);
+
+    struct get_groups_params {
+        optional<group_name> start;
+        optional<uint32_t>   limit;
+    };
+    fc::variant get_groups(const get_groups_params& params);
+
 #ifdef ENABLE_MONGODB
     struct get_my_params {
         std::vector<std::string> signatures;
@@ -73,6 +98,9 @@ public:
     fc::variant get_my_tokens(const get_my_params& params);
     fc::variant get_my_domains(const get_my_params& params);
     fc::variant get_my_groups(const get_my_params& params);
+
+    using get_mongodb_stats_params = chain_apis::empty;
+    mongo_db_stats get_mongodb_stats(const get_mongodb_stats_params& params);
 #endif
 
 private:
@@ -116,6 +144,9 @@ FC_REFLECT(evt::evt_apis::read_only::get_domain_params, (name));
 FC_REFLECT(evt::evt_apis::read_only::get_group_params, (name));
 FC_REFLECT(evt::evt_apis::read_only::get_token_params, (domain)(name));
 FC_REFLECT(evt::evt_apis::read_only::get_account_params, (name));
+FC_REFLECT(evt::evt_apis::read_only::get_domains_params, (start)(limit));
+FC_REFLECT(evt::evt_apis::read_only::get_tokens_params, (domain)(start)(limit));
+FC_REFLECT(evt::evt_apis::read_only::get_groups_params, (start)(limit));
 #ifdef ENABLE_MONGODB
 FC_REFLECT(evt::evt_apis::read_only::get_my_params, (signatures));
 #endif
\ No newline at end of file
@@ -4,6 +4,7 @@
  */
 #include <evt/http_plugin/http_plugin.hpp>
 #include <evt/chain/exceptions.hpp>
+#include <evt/chain/thread_pool.hpp>
 
 #include <fc/crypto/openssl.hpp>
 #include <fc/io/json.hpp>
@@ -21,6 +22,7 @@
 #include <websocketpp/server.hpp>
 
 #include <memory>
+#include <mutex>
 #include <thread>
 
 namespace evt {
@@ -77,9 +79,21 @@ using websocket_server_type     = websocketpp::server<detail::asio_with_stub_log
 using websocket_server_tls_type = websocketpp::server<detail::asio_with_stub_log<websocketpp::transport::asio::tls_socket::endpoint>>;
 using ssl_context_ptr           = websocketpp::lib::shared_ptr<websocketpp::lib::asio::ssl::context>;
 
+constexpr auto def_http_threads = 2;
+
+struct registered_handler {
+    url_handler handler;
+    bool        concurrent;  // called on http threads instead of main thread
+};
+
 class http_plugin_impl {
 public:
-    map<string, url_handler> url_handlers;
+    // handlers are added by other plugins on main thread while http threads are serving requests
+    map<string, registered_handler> url_handlers;
+    std::mutex                      url_handlers_mutex;
+
+    std::unique_ptr<chain::thread_pool> thread_pool;  // runs the servers and concurrent handlers
+
     optional<tcp::endpoint>  listen_endpoint;
     string                   access_control_allow_origin;
     string                   access_control_allow_headers;
@@ -133,6 +147,27 @@ public:
         return ctx;
     }
 
+    bool
+    has_http_threads() const {
+        return thread_pool && thread_pool->size() > 0;
+    }
+
+    asio::io_service&
+    get_http_io_service() {
+        return has_http_threads() ? thread_pool->get_io_service() : app().get_io_service();
+    }
+
+    optional<registered_handler>
+    find_handler(const string& resource) {
+        std::lock_guard<std::mutex> lock(url_handlers_mutex);
+
+        auto it = url_handlers.find(resource);
+        if(it == url_handlers.end()) {
+            return optional<registered_handler>();
+        }
+        return it->second;
+    }
+
     template <class T>
     static void
     handle_exception(typename websocketpp::server<detail::asio_with_stub_log<T>>::connection_ptr con) {
@@ -193,15 +228,32 @@ public:
             }
 
             con->append_header("Content-type", "application/json");
-            auto body        = con->get_request_body();
-            auto resource    = con->get_uri()->get_resource();
-            auto handler_itr = url_handlers.find(resource);
-            if(handler_itr != url_handlers.end()) {
+            auto body     = con->get_request_body();
+            auto resource = con->get_uri()->get_resource();
+            auto handler  = find_handler(resource);
+            if(handler) {
                 con->defer_http_response();
-                handler_itr->second(resource, body, [con](auto code, auto&& body) {
-                    con->set_body(std::move(body));
-                    con->set_status(websocketpp::http::status_code::value(code));
-                    con->send_http_response();
+
+                // response is always sent on the thread which serves the connection
+                auto& ios = get_http_io_service();
+                auto  cb  = url_response_callback([&ios, con](int code, string body) {
+                    ios.post([con, code, body = std::move(body)]() mutable {
+                        con->set_body(std::move(body));
+                        con->set_status(websocketpp::http::status_code::value(code));
+                        con->send_http_response();
+                    });
+                });
+                if(handler->concurrent || !has_http_threads()) {
+                    handler->handler(resource, body, cb);
+                    return;
+                }
+                app().get_io_service().post([h = std::move(handler->handler), resource, body = std::move(body), cb] {
+                    try {
+                        h(resource, body, cb);
+                    }
+                    catch(...) {
+                        http_plugin::handle_exception("http", resource.c_str(), body, cb);
+                    }
                 });
             }
             else {
@@ -222,7 +274,7 @@ public:
     create_server_for_endpoint(const tcp::endpoint& ep, websocketpp::server<detail::asio_with_stub_log<T>>& ws) {
         try {
             ws.clear_access_channels(websocketpp::log::alevel::all);
-            ws.init_asio(&app().get_io_service());
+            ws.init_asio(&get_http_io_service());
             ws.set_reuse_addr(true);
 
             ws.set_http_handler([&](connection_hdl hdl) {
@@ -268,11 +320,14 @@ http_plugin::set_program_options(options_description&, options_description& cfg)
             my->access_control_allow_credentials = v;
             if(v)
                 ilog("configured http with Access-Control-Allow-Credentials: true");
-            })->default_value(false), "Specify if Access-Control-Allow-Credentials: true should be returned on each request.");
+            })->default_value(false), "Specify if Access-Control-Allow-Credentials: true should be returned on each request.")
+        ("http-threads", bpo::value<uint16_t>()->default_value(def_http_threads), "Number of threads which serve http requests and run the concurrent handlers, use 0 to serve them on the main thread");
 }
 
 void
 http_plugin::plugin_initialize(const variables_map& options) {
+    my->thread_pool.reset(new chain::thread_pool(options.at("http-threads").as<uint16_t>()));
+
     tcp::resolver resolver(app().get_io_service());
     if(options.count("http-server-address") && options.at("http-server-address").as<string>().length()) {
         string               lipstr = options.at("http-server-address").as<string>();
@@ -368,18 +423,34 @@ http_plugin::plugin_startup() {
 
 void
 http_plugin::plugin_shutdown() {
+    stop_http_threads();
+}
+
+void
+http_plugin::stop_http_threads() {
     if(my->server.is_listening())
         my->server.stop_listening();
     if(my->https_server.is_listening())
         my->https_server.stop_listening();
+    if(my->thread_pool) {
+        // open connections keep the io_service busy, stop it rather than waiting for them
+        my->thread_pool->get_io_service().stop();
+        my->thread_pool->stop();
+    }
 }
 
 void
 http_plugin::add_handler(const string& url, const url_handler& handler) {
     ilog("add api url: ${c}", ("c", url));
-    app().get_io_service().post([=]() {
-        my->url_handlers.insert(std::make_pair(url, handler));
-    });
+    std::lock_guard<std::mutex> lock(my->url_handlers_mutex);
+    my->url_handlers.insert(std::make_pair(url, registered_handler{handler, false}));
+}
+
+void
+http_plugin::add_concurrent_handler(const string& url, const url_handler& handler) {
+    ilog("add concurrent api url: ${c}", ("c", url));
+    std::lock_guard<std::mutex> lock(my->url_handlers_mutex);
+    my->url_handlers.insert(std::make_pair(url, registered_handler{handler, true}));
 }
 
 void
@@ -47,10 +47,11 @@ using api_description = std::map<string, url_handler>;
     *  called with the response code and body.
     *
     *  The handler will be called from the appbase application io_service
-    *  thread.  The callback can be called from any thread and will 
-    *  automatically propagate the call to the http thread.
+    *  thread, unless it's added as a concurrent one, which is called from
+    *  the http threads directly. The callback can be called from any thread
+    *  and will automatically propagate the call to the http thread.
     *
-    *  The HTTP service will run in its own thread with its own io_service to
+    *  The HTTP service will run in its own threads with its own io_service to
     *  make sure that HTTP request processing does not interfer with other
     *  plugins.  
     */
@@ -73,6 +74,19 @@ public:
             add_handler(call.first, call.second);
     }
 
+    // concurrent handlers are called from multiple http threads at the same time,
+    // they must only touch thread-safe states, like block log and token database snapshots.
+    void add_concurrent_handler(const string& url, const url_handler&);
+    void
+    add_concurrent_api(const api_description& api) {
+        for(const auto& call : api)
+            add_concurrent_handler(call.first, call.second);
+    }
+
+    // stops serving requests and waits for the running concurrent handlers. Plugins which add concurrent
+    // handlers are shut down before http_plugin, they should call it first so no handler outlives them.
+    void stop_http_threads();
+
     // standard exception handling for api handlers
     static void handle_exception(const char *api_name, const char *call_name, const string& body, url_response_callback cb);
 
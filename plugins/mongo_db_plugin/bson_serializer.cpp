@@ -0,0 +1,217 @@
+/**
+ *  @file
+ *  @copyright defined in evt/LICENSE.txt
+ */
+#include <evt/mongo_db_plugin/bson_serializer.hpp>
+#include <limits>
+#include <type_traits>
+#include <unordered_map>
+#include <fc/io/raw.hpp>
+#include <bsoncxx/types.hpp>
+
+namespace evt {
+
+namespace __internal {
+
+using append_func = void (*)(bsoncxx::builder::core&, fc::datastream<const char*>&);
+
+// integers larger than 32 bits are written as strings by fc::json,
+// others are parsed back as int32 or int64 by bsoncxx::from_json
+void
+append_integer(bsoncxx::builder::core& c, int64_t i) {
+    if(i > 0xffffffffll) {
+        c.append(std::to_string(i));
+    }
+    else if(i >= std::numeric_limits<int32_t>::min() && i <= std::numeric_limits<int32_t>::max()) {
+        c.append(bsoncxx::types::b_int32{(int32_t)i});
+    }
+    else {
+        c.append(bsoncxx::types::b_int64{i});
+    }
+}
+
+void
+append_integer(bsoncxx::builder::core& c, uint64_t i) {
+    if(i > 0xffffffffull) {
+        c.append(std::to_string(i));
+    }
+    else if(i <= (uint64_t)std::numeric_limits<int32_t>::max()) {
+        c.append(bsoncxx::types::b_int32{(int32_t)i});
+    }
+    else {
+        c.append(bsoncxx::types::b_int64{(int64_t)i});
+    }
+}
+
+template <typename T>
+void
+append_raw_integer(bsoncxx::builder::core& c, fc::datastream<const char*>& ds) {
+    using wide_type = std::conditional_t<std::is_signed<T>::value, int64_t, uint64_t>;
+
+    T i;
+    fc::raw::unpack(ds, i);
+    append_integer(c, (wide_type)i);
+}
+
+template <typename T>
+void
+append_raw_string(bsoncxx::builder::core& c, fc::datastream<const char*>& ds) {
+    T v;
+    fc::raw::unpack(ds, v);
+    c.append((std::string)v);
+}
+
+// built-in types which are converted directly, others are converted from their variants
+const std::unordered_map<std::string, append_func>&
+get_builtin_appenders() {
+    static auto appenders = std::unordered_map<std::string, append_func>{
+        {"bool", &append_raw_integer<uint8_t>},
+        {"int8", &append_raw_integer<int8_t>},
+        {"uint8", &append_raw_integer<uint8_t>},
+        {"int16", &append_raw_integer<int16_t>},
+        {"uint16", &append_raw_integer<uint16_t>},
+        {"int32", &append_raw_integer<int32_t>},
+        {"uint32", &append_raw_integer<uint32_t>},
+        {"int64", &append_raw_integer<int64_t>},
+        {"uint64", &append_raw_integer<uint64_t>},
+        {"string", &append_raw_string<std::string>},
+        {"name", &append_raw_string<chain::name>},
+        {"name128", &append_raw_string<chain::name128>}};
+    return appenders;
+}
+
+}  // namespace __internal
+
+void
+bson_serializer::append_variant(bsoncxx::builder::core& c, const fc::variant& v) {
+    using namespace __internal;
+
+    switch(v.get_type()) {
+    case fc::variant::null_type: {
+        c.append(bsoncxx::types::b_null{});
+        break;
+    }
+    case fc::variant::int64_type: {
+        append_integer(c, v.as_int64());
+        break;
+    }
+    case fc::variant::uint64_type: {
+        append_integer(c, v.as_uint64());
+        break;
+    }
+    case fc::variant::double_type: {
+        c.append(v.as_string());
+        break;
+    }
+    case fc::variant::bool_type: {
+        c.append(v.as_bool());
+        break;
+    }
+    case fc::variant::string_type: {
+        c.append(v.get_string());
+        break;
+    }
+    case fc::variant::blob_type: {
+        c.append(v.as_string());
+        break;
+    }
+    case fc::variant::array_type: {
+        c.open_array();
+        for(auto& e : v.get_array()) {
+            append_variant(c, e);
+        }
+        c.close_array();
+        break;
+    }
+    case fc::variant::object_type: {
+        c.open_document();
+        for(auto& kv : v.get_object()) {
+            c.key_owned(kv.key());
+            append_variant(c, kv.value());
+        }
+        c.close_document();
+        break;
+    }
+    default: {
+        FC_THROW_EXCEPTION(fc::invalid_arg_exception, "Unsupported variant type: " + std::to_string(v.get_type()));
+    }
+    }  // switch
+}
+
+bsoncxx::document::value
+bson_serializer::variant_to_bson(const fc::variant& v) {
+    auto c = bsoncxx::builder::core(false);
+    for(auto& kv : v.get_object()) {
+        c.key_owned(kv.key());
+        append_variant(c, kv.value());
+    }
+    return c.extract_document();
+}
+
+void
+bson_serializer::append_builtin(bsoncxx::builder::core& c, const abi_serializer& abi, const type_name& type, fc::datastream<const char*>& ds) {
+    auto& appenders = __internal::get_builtin_appenders();
+
+    auto it = appenders.find(type);
+    if(it != appenders.end()) {
+        it->second(c, ds);
+        return;
+    }
+    append_variant(c, abi.built_in_types.at(type).first(ds, false, false));
+}
+
+void
+bson_serializer::append_fields(bsoncxx::builder::core& c, const abi_serializer& abi, const type_name& type, fc::datastream<const char*>& ds) {
+    const auto& st = abi.get_struct(type);
+    if(st.base != type_name()) {
+        append_fields(c, abi, abi.resolve_type(st.base), ds);
+    }
+    for(const auto& field : st.fields) {
+        c.key_owned(field.name);
+        append_binary(c, abi, field.type, ds);
+    }
+}
+
+void
+bson_serializer::append_binary(bsoncxx::builder::core& c, const abi_serializer& abi, const type_name& type, fc::datastream<const char*>& ds) {
+    auto rtype = abi.resolve_type(type);
+    auto ftype = abi.fundamental_type(rtype);
+
+    if(abi.is_array(rtype)) {
+        fc::unsigned_int size;
+        fc::raw::unpack(ds, size);
+        c.open_array();
+        for(auto i = 0u; i < size.value; i++) {
+            append_binary(c, abi, ftype, ds);
+        }
+        c.close_array();
+    }
+    else if(abi.is_optional(rtype)) {
+        char flag;
+        fc::raw::unpack(ds, flag);
+        if(flag) {
+            append_binary(c, abi, ftype, ds);
+        }
+        else {
+            c.append(bsoncxx::types::b_null{});
+        }
+    }
+    else if(abi.is_builtin_type(rtype)) {
+        append_builtin(c, abi, rtype, ds);
+    }
+    else {
+        c.open_document();
+        append_fields(c, abi, rtype, ds);
+        c.close_document();
+    }
+}
+
+bsoncxx::document::value
+bson_serializer::binary_to_bson(const abi_serializer& abi, const type_name& type, const bytes& binary) {
+    auto ds = fc::datastream<const char*>(binary.data(), binary.size());
+    auto c  = bsoncxx::builder::core(false);
+    append_fields(c, abi, abi.resolve_type(type), ds);
+    return c.extract_document();
+}
+
+}  // namespace evt
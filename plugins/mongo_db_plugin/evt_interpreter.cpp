@@ -3,76 +3,45 @@
  *  @copyright defined in evt/LICENSE.txt
  */
 #include <evt/mongo_db_plugin/evt_interpreter.hpp>
+#include <evt/mongo_db_plugin/bson_serializer.hpp>
+#include <evt/mongo_db_plugin/write_context.hpp>
 #include <evt/chain/contracts/types.hpp>
 
-#include <fc/io/json.hpp>
-
 #include <bsoncxx/builder/basic/document.hpp>
 #include <bsoncxx/builder/basic/kvp.hpp>
-#include <bsoncxx/builder/stream/document.hpp>
-#include <bsoncxx/json.hpp>
 
-#include <mongocxx/client.hpp>
-#include <mongocxx/instance.hpp>
-#include <mongocxx/database.hpp>
+#include <mongocxx/model/update_one.hpp>
 
 namespace evt {
 
 using namespace evt::chain::contracts;
-using mongocxx::bulk_write;
+using bsoncxx::builder::basic::kvp;
+using bsoncxx::builder::basic::sub_array;
+using bsoncxx::builder::basic::sub_document;
 
 class interpreter_impl {
 public:
-    void initialize_db(const mongocxx::database& db);
-    void process_trx(const transaction_trace& trx_trace);
-
-private:
-    void process_newdomain(const newdomain& nd);
-    void process_updatedomain(const updatedomain& ud);
-    void process_issuetoken(const issuetoken& it);
-    void process_transfer(const transfer& tt);
-    void process_newgroup(const newgroup& ng);
-    void process_updategroup(const updategroup& ug);
-    void process_newaccount(const newaccount& na);
-    void process_updateowner(const updateowner& uo);
+    void process_trx(const transaction_trace& trx_trace, write_context& write_ctx);
 
 private:
-    mongocxx::database    db_;
-    mongocxx::collection  domains_collection_;
-    mongocxx::collection  tokens_collection_;
-    mongocxx::collection  groups_collection_;
-    mongocxx::collection  accounts_collection_;
-
-public:
-    static const std::string domains_col;
-    static const std::string tokens_col;
-    static const std::string groups_col;
-    static const std::string accounts_col;
+    void process_newdomain(const newdomain& nd, write_context& write_ctx);
+    void process_updatedomain(const updatedomain& ud, write_context& write_ctx);
+    void process_issuetoken(const issuetoken& it, write_context& write_ctx);
+    void process_transfer(const transfer& tt, write_context& write_ctx);
+    void process_newgroup(const newgroup& ng, write_context& write_ctx);
+    void process_updategroup(const updategroup& ug, write_context& write_ctx);
+    void process_newaccount(const newaccount& na, write_context& write_ctx);
+    void process_updateowner(const updateowner& uo, write_context& write_ctx);
 };
 
-const std::string interpreter_impl::domains_col  = "Domains";
-const std::string interpreter_impl::tokens_col   = "Tokens";
-const std::string interpreter_impl::groups_col   = "Groups";
-const std::string interpreter_impl::accounts_col = "Accounts";
-
-void
-interpreter_impl::initialize_db(const mongocxx::database& db)
-{
-    db_ = db;
-    domains_collection_  = db_[domains_col];
-    tokens_collection_   = db_[tokens_col];
-    groups_collection_   = db_[groups_col];
-    accounts_collection_ = db_[accounts_col];
-}
-
-#define CASE_N_CALL(name)                        \
-    case N(name): {                              \
-        process_##name(act.data_as<name>()); \
-        break;                                   \
+#define CASE_N_CALL(name)                               \
+    case N(name): {                                     \
+        process_##name(act.data_as<name>(), write_ctx); \
+        break;                                          \
     }
 
 void
-interpreter_impl::process_trx(const transaction_trace& trx_trace) {
+interpreter_impl::process_trx(const transaction_trace& trx_trace, write_context& write_ctx) {
     for(auto& act_trace : trx_trace.action_traces) {
         auto& act = act_trace.act;
         switch((uint64_t)act.name) {
@@ -92,315 +61,166 @@ interpreter_impl::process_trx(const transaction_trace& trx_trace) {
 namespace __internal {
 
 auto
-find_domain(mongocxx::collection& domains, const std::string& name) {
-    using bsoncxx::builder::stream::document;
-    document find{};
-    find << "name" << name;
-    auto domain = domains.find_one(find.view());
-    if(!domain) {
-        FC_THROW("Unable to find domain ${name}", ("name", name));
-    }
-    return *domain;
+get_now() {
+    return bsoncxx::types::b_date{std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()})};
 }
 
+template <typename T>
 auto
-find_token(mongocxx::collection& tokens, const std::string& domain, const std::string& name) {
-    using bsoncxx::builder::stream::document;
-    document find{};
-    find << "token_id" << domain + "-" + name;
-    auto token = tokens.find_one(find.view());
-    if(!token) {
-        FC_THROW("Unable to find token ${domain}-${name}", ("domain",domain)("name", name));
-    }
-    return *token;
+to_bson(const T& v) {
+    fc::variant u;
+    fc::to_variant(v, u);
+    return bson_serializer::variant_to_bson(u);
 }
 
+template <typename T>
 auto
-find_group(mongocxx::collection& groups, const std::string& name) {
-    using bsoncxx::builder::stream::document;
-    document find{};
-    find << "name" << name;
-    auto group = groups.find_one(find.view());
-    if(!group) {
-        FC_THROW("Unable to find group ${name}", ("name", name));
-    }
-    return *group;
+append_keys(const T& keys) {
+    return [&keys](sub_array subarr) {
+        for(const auto& k : keys) {
+            subarr.append((std::string)k);
+        }
+    };
 }
 
-auto
-find_account(mongocxx::collection& accounts, const std::string& name) {
-    using bsoncxx::builder::stream::document;
-    document find{};
-    find << "name" << name;
-    auto account = accounts.find_one(find.view());
-    if(!account) {
-        FC_THROW("Unable to find account ${name}", ("name", name));
-    }
-    return *account;
+// documents are keyed by `key_name`, no need to read them before writing.
+// created document is upserted, so indexing the same action again overwrites it
+template <typename SetFunc>
+void
+upsert_one(bulk_writer& writer, const char* key_name, const std::string& key, SetFunc&& set) {
+    auto filter = bsoncxx::builder::basic::make_document(kvp(key_name, key));
+    auto doc    = bsoncxx::builder::basic::document{};
+    auto now    = get_now();
+    doc.append(kvp("$set", [&](sub_document subdoc) {
+                   subdoc.append(kvp(key_name, key));
+                   set(subdoc);
+               }),
+               kvp("$setOnInsert", [&](sub_document subdoc) {
+                   subdoc.append(kvp("created_at", now));
+               }));
+
+    auto op = mongocxx::model::update_one{filter.view(), doc.view()};
+    op.upsert(true);
+    writer.append(op);
+}
+
+template <typename SetFunc>
+void
+update_one(bulk_writer& writer, const char* key_name, const std::string& key, SetFunc&& set) {
+    auto filter = bsoncxx::builder::basic::make_document(kvp(key_name, key));
+    auto doc    = bsoncxx::builder::basic::document{};
+    doc.append(kvp("$set", [&](sub_document subdoc) {
+        set(subdoc);
+    }));
+
+    auto op = mongocxx::model::update_one{filter.view(), doc.view()};
+    writer.append(op);
 }
 
 }  // namespace __internal
 
 void
-interpreter_impl::process_newdomain(const newdomain& nd) {
-    using namespace bsoncxx::types;
-    using namespace bsoncxx::builder;
-    using bsoncxx::builder::basic::kvp;
-
-    auto oid = bsoncxx::oid{};
-    auto doc = bsoncxx::builder::basic::document{};
-
-    fc::variant issue, transfer, manage;
-    fc::to_variant(nd.issue, issue);
-    fc::to_variant(nd.transfer, transfer);
-    fc::to_variant(nd.manage, manage);
-
-    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
-
-    doc.append(kvp("_id", oid),
-               kvp("name", (std::string)nd.name),
-               kvp("issuer", (std::string)nd.issuer),
-               kvp("issue", bsoncxx::from_json(fc::json::to_string(issue))),
-               kvp("transfer", bsoncxx::from_json(fc::json::to_string(transfer))),
-               kvp("manage", bsoncxx::from_json(fc::json::to_string(manage))));
-    doc.append(kvp("created_at", b_date{now}));
-
-    if(!domains_collection_.insert_one(doc.view())) {
-        elog("Failed to insert domain ${name}", ("name", nd.name));
-    }
+interpreter_impl::process_newdomain(const newdomain& nd, write_context& write_ctx) {
+    using namespace __internal;
+
+    upsert_one(write_ctx.domains, "name", (std::string)nd.name, [&](sub_document doc) {
+        doc.append(kvp("issuer", (std::string)nd.issuer),
+                   kvp("issue", to_bson(nd.issue)),
+                   kvp("transfer", to_bson(nd.transfer)),
+                   kvp("manage", to_bson(nd.manage)));
+    });
 }
 
 void
-interpreter_impl::process_updatedomain(const updatedomain& ud) {
+interpreter_impl::process_updatedomain(const updatedomain& ud, write_context& write_ctx) {
     using namespace __internal;
-    using namespace bsoncxx::types;
-    using namespace bsoncxx::builder;
-    using bsoncxx::builder::basic::kvp;
-    using bsoncxx::builder::stream::close_document;
-    using bsoncxx::builder::stream::document;
-    using bsoncxx::builder::stream::finalize;
-    using bsoncxx::builder::stream::open_document;
-
-    auto name = (std::string)ud.name;
-    auto now  = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
-
-    auto d = find_domain(domains_collection_, name);
-
-    document update{};
-    update << "$set" << open_document;
-    if(ud.issue.valid()) {
-        fc::variant u;
-        fc::to_variant(*ud.issue, u);
-        update << "issue" << bsoncxx::from_json(fc::json::to_string(u));
-    }
-    if(ud.transfer.valid()) {
-        fc::variant u;
-        fc::to_variant(*ud.transfer, u);
-        update << "transfer" << bsoncxx::from_json(fc::json::to_string(u));
-    }
-    if(ud.manage.valid()) {
-        fc::variant u;
-        fc::to_variant(*ud.manage, u);
-        update << "manage" << bsoncxx::from_json(fc::json::to_string(u));
-    }
-
-    update << "updatedAt" << b_date{now}
-           << close_document;
 
-    if(!domains_collection_.update_one(document{} << "_id" << d.view()["_id"].get_oid() << finalize, update.view())) {
-        elog("Failed to update domain ${name}", ("name", ud.name));
-    }
+    update_one(write_ctx.domains, "name", (std::string)ud.name, [&](sub_document doc) {
+        if(ud.issue.valid()) {
+            doc.append(kvp("issue", to_bson(*ud.issue)));
+        }
+        if(ud.transfer.valid()) {
+            doc.append(kvp("transfer", to_bson(*ud.transfer)));
+        }
+        if(ud.manage.valid()) {
+            doc.append(kvp("manage", to_bson(*ud.manage)));
+        }
+        doc.append(kvp("updatedAt", get_now()));
+    });
 }
 
 void
-interpreter_impl::process_issuetoken(const issuetoken& it) {
-    using namespace bsoncxx::types;
-    using namespace bsoncxx::builder;
-    using bsoncxx::builder::basic::kvp;
-
-    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
+interpreter_impl::process_issuetoken(const issuetoken& it, write_context& write_ctx) {
+    using namespace __internal;
 
-    mongocxx::bulk_write bulk{};
     auto d = (std::string)it.domain;
     for(auto& n : it.names) {
-        auto doc = bsoncxx::builder::basic::document{};
-        auto oid = bsoncxx::oid{};
         auto name = (std::string)n;
-        doc.append(kvp("_id", oid),
-                   kvp("token_id", d + "-" + name),
-                   kvp("domain", d),
-                   kvp("name", name),
-                   /// TODO: Cache owner list to improve performance
-                   kvp("owner", [&it](bsoncxx::builder::basic::sub_array subarr) {
-                       for(const auto& o : it.owner) {
-                           subarr.append((std::string)o);
-                       }
-                   }));
-        doc.append(kvp("created_at", b_date{now}));
-        mongocxx::model::insert_one insert_op{doc.view()};
-        bulk.append(insert_op);
-    }
-
-    if(!tokens_collection_.bulk_write(bulk)) {
-        elog("Bulk insert tokens failed for domain: ${name}", ("name", d));
+        upsert_one(write_ctx.tokens, "token_id", d + "-" + name, [&](sub_document doc) {
+            doc.append(kvp("domain", d),
+                       kvp("name", name),
+                       kvp("owner", append_keys(it.owner)));
+        });
     }
 }
 
 void
-interpreter_impl::process_transfer(const transfer& tt) {
+interpreter_impl::process_transfer(const transfer& tt, write_context& write_ctx) {
     using namespace __internal;
-    using namespace bsoncxx::types;
-    using namespace bsoncxx::builder;
-    using bsoncxx::builder::basic::kvp;
-    using bsoncxx::builder::stream::close_document;
-    using bsoncxx::builder::stream::document;
-    using bsoncxx::builder::stream::finalize;
-    using bsoncxx::builder::stream::open_document;
-
-    auto now  = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
-
-    auto t = find_token(tokens_collection_, (std::string)tt.domain, (std::string)tt.name);
-
-    auto update = bsoncxx::builder::basic::document{};
-    update.append(kvp("owner", [&tt](bsoncxx::builder::basic::sub_array subarr) {
-           for(const auto& o : tt.to) {
-               subarr.append((std::string)o);
-           }
-       }));
-
-    update.append(kvp("updated_at", b_date{now}));
-    if(!tokens_collection_.update_one(document{} << "_id" << t.view()["_id"].get_oid() << finalize, update.view())) {
-        elog("Failed to update token: ${domain}-${name}", ("domain",tt.domain)("name", tt.name));
-    }
+
+    update_one(write_ctx.tokens, "token_id", (std::string)tt.domain + "-" + (std::string)tt.name, [&](sub_document doc) {
+        doc.append(kvp("owner", append_keys(tt.to)),
+                   kvp("updated_at", get_now()));
+    });
 }
 
 void
-interpreter_impl::process_newgroup(const newgroup& ng) {
-    using namespace bsoncxx::types;
-    using namespace bsoncxx::builder;
-    using bsoncxx::builder::basic::kvp;
-
-    auto oid = bsoncxx::oid{};
-    auto doc = bsoncxx::builder::basic::document{};
-
-    fc::variant def;
-    fc::to_variant(ng.group, def);
-
-    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
-
-    doc.append(kvp("_id", oid),
-               kvp("name", (std::string)ng.name),
-               kvp("def", bsoncxx::from_json(fc::json::to_string(def))));
-    doc.append(kvp("created_at", b_date{now}));
+interpreter_impl::process_newgroup(const newgroup& ng, write_context& write_ctx) {
+    using namespace __internal;
 
-    if(!groups_collection_.insert_one(doc.view())) {
-        elog("Failed to insert group ${name}", ("name", ng.name));
-    }
+    upsert_one(write_ctx.groups, "name", (std::string)ng.name, [&](sub_document doc) {
+        doc.append(kvp("def", to_bson(ng.group)));
+    });
 }
 
 void
-interpreter_impl::process_updategroup(const updategroup& ug) {
+interpreter_impl::process_updategroup(const updategroup& ug, write_context& write_ctx) {
     using namespace __internal;
-    using namespace bsoncxx::types;
-    using namespace bsoncxx::builder;
-    using bsoncxx::builder::basic::kvp;
-    using bsoncxx::builder::stream::close_document;
-    using bsoncxx::builder::stream::document;
-    using bsoncxx::builder::stream::finalize;
-    using bsoncxx::builder::stream::open_document;
-
-    auto name = (std::string)ug.name;
-    auto now  = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
-
-    auto g = find_group(groups_collection_, name);
-
-    document update{};
-    update << "$set" << open_document;
-    fc::variant u;
-    fc::to_variant(ug.group, u);
-    update << "def" << bsoncxx::from_json(fc::json::to_string(u));
-    update << "updated_at" << b_date{now}
-           << close_document;
 
-    if(!groups_collection_.update_one(document{} << "_id" << g.view()["_id"].get_oid() << finalize, update.view())) {
-        elog("Failed to update group ${name}", ("name", ug.name));
-    }
+    update_one(write_ctx.groups, "name", (std::string)ug.name, [&](sub_document doc) {
+        doc.append(kvp("def", to_bson(ug.group)),
+                   kvp("updated_at", get_now()));
+    });
 }
 
 void
-interpreter_impl::process_newaccount(const newaccount& na) {
-    using namespace bsoncxx::types;
-    using namespace bsoncxx::builder;
-    using bsoncxx::builder::basic::kvp;
-
-    auto oid = bsoncxx::oid{};
-    auto doc = bsoncxx::builder::basic::document{};
-
-    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
+interpreter_impl::process_newaccount(const newaccount& na, write_context& write_ctx) {
+    using namespace __internal;
 
     // NOTICE: balance below is defined the same as /chain/contracts/evt_contract.cpp:L249
-    doc.append(kvp("_id", oid),
-               kvp("name", (std::string)na.name),
-               kvp("balance", (std::string)balance_type(10000)),
-               kvp("frozen", (std::string)balance_type(0)));
-    doc.append(kvp("owner", [&na](bsoncxx::builder::basic::sub_array subarr) {
-           for(const auto& o : na.owner) {
-               subarr.append((std::string)o);
-           }
-       }));
-    doc.append(kvp("created_at", b_date{now}));
-
-    if(!accounts_collection_.insert_one(doc.view())) {
-        elog("Failed to insert account ${name}", ("name", na.name));
-    }
+    upsert_one(write_ctx.accounts, "name", (std::string)na.name, [&](sub_document doc) {
+        doc.append(kvp("balance", (std::string)balance_type(10000)),
+                   kvp("frozen", (std::string)balance_type(0)),
+                   kvp("owner", append_keys(na.owner)));
+    });
 }
 
 void
-interpreter_impl::process_updateowner(const updateowner& uo) {
+interpreter_impl::process_updateowner(const updateowner& uo, write_context& write_ctx) {
     using namespace __internal;
-    using namespace bsoncxx::types;
-    using namespace bsoncxx::builder;
-    using bsoncxx::builder::basic::kvp;
-    using bsoncxx::builder::stream::close_document;
-    using bsoncxx::builder::stream::document;
-    using bsoncxx::builder::stream::finalize;
-    using bsoncxx::builder::stream::open_document;
-
-    auto now  = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
-
-    auto t = find_account(accounts_collection_, (std::string)uo.name);
-
-    auto update = bsoncxx::builder::basic::document{};
-    update.append(kvp("owner", [&uo](bsoncxx::builder::basic::sub_array subarr) {
-           for(const auto& o : uo.owner) {
-               subarr.append((std::string)o);
-           }
-       }));
-
-    update.append(kvp("updated_at", b_date{now}));
-    if(!accounts_collection_.update_one(document{} << "_id" << t.view()["_id"].get_oid() << finalize, update.view())) {
-        elog("Failed to update account ${name}", ("name", uo.name));
-    }
+
+    update_one(write_ctx.accounts, "name", (std::string)uo.name, [&](sub_document doc) {
+        doc.append(kvp("owner", append_keys(uo.owner)),
+                   kvp("updated_at", get_now()));
+    });
 }
 
 evt_interpreter::evt_interpreter() : my_(new interpreter_impl()) {}
 
 void
-evt_interpreter::initialize_db(const mongocxx::database& db) {
-    my_->initialize_db(db);
-}
-
-void
-evt_interpreter::process_trx(const transaction_trace& trx_trace) {
-    my_->process_trx(trx_trace);
+evt_interpreter::process_trx(const transaction_trace& trx_trace, write_context& write_ctx) {
+    my_->process_trx(trx_trace, write_ctx);
 }
 
 }  // namespace evt
\ No newline at end of file
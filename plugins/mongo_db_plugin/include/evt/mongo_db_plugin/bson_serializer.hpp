@@ -0,0 +1,39 @@
+/**
+ *  @file
+ *  @copyright defined in evt/LICENSE.txt
+ */
+#pragma once
+#include <bsoncxx/builder/core.hpp>
+#include <bsoncxx/document/value.hpp>
+#include <evt/chain/contracts/abi_serializer.hpp>
+
+namespace evt {
+
+using evt::chain::bytes;
+using evt::chain::contracts::abi_serializer;
+using evt::chain::contracts::type_name;
+
+/**
+ * Converts variants and ABI encoded binaries into BSON without going through JSON.
+ * Values are the same as converting the JSON string produced by `fc::json::to_string`
+ * with `bsoncxx::from_json`, so the documents don't change whichever way they're built.
+ */
+class bson_serializer {
+public:
+    // `v` must be an object
+    static bsoncxx::document::value variant_to_bson(const fc::variant& v);
+
+    // walks the struct definitions of `abi` and appends the fields of `type` straight into the document
+    static bsoncxx::document::value binary_to_bson(const abi_serializer& abi, const type_name& type, const bytes& binary);
+
+public:
+    // appends `v` as the value of the current key, or as the next element of array
+    static void append_variant(bsoncxx::builder::core& c, const fc::variant& v);
+
+private:
+    static void append_binary(bsoncxx::builder::core& c, const abi_serializer& abi, const type_name& type, fc::datastream<const char*>& ds);
+    static void append_fields(bsoncxx::builder::core& c, const abi_serializer& abi, const type_name& type, fc::datastream<const char*>& ds);
+    static void append_builtin(bsoncxx::builder::core& c, const abi_serializer& abi, const type_name& type, fc::datastream<const char*>& ds);
+};
+
+}  // namespace evt
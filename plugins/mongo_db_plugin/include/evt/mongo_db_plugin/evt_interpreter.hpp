@@ -5,13 +5,13 @@
 #pragma once
 #include <memory>
 #include <functional>
-#include <mongocxx/database.hpp>
 #include <evt/chain/trace.hpp>
 
 namespace evt {
 
 using evt::chain::transaction_trace;
 
+struct write_context;
 class interpreter_impl;
 using interpreter_impl_ptr = std::shared_ptr<interpreter_impl>;
 
@@ -20,8 +20,8 @@ public:
     evt_interpreter();
 
 public:
-    void initialize_db(const mongocxx::database& db);
-    void process_trx(const transaction_trace& trx_trace);
+    // documents are appended into `write_ctx`, and written when it's committed
+    void process_trx(const transaction_trace& trx_trace, write_context& write_ctx);
 
 private:
     interpreter_impl_ptr my_;
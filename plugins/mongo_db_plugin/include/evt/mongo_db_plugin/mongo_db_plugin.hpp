@@ -9,12 +9,23 @@
 #include <evt/chain/types.hpp>
 #include <fc/container/flat_fwd.hpp>
 #include <memory>
+#include <boost/thread/shared_mutex.hpp>
 
 namespace evt {
 
 using mongo_db_plugin_impl_ptr = std::shared_ptr<class mongo_db_plugin_impl>;
 using evt::chain::public_key_type;
 
+struct mongo_db_stats {
+    uint32_t max_queue_size         = 0;
+    uint32_t queued_blocks          = 0;
+    uint32_t queued_transactions    = 0;
+    uint32_t last_queued_block_num  = 0;
+    uint32_t last_written_block_num = 0;  // documents of blocks before it are all written
+    uint32_t lag_blocks             = 0;
+    uint64_t blocked_time_ms        = 0;  // total time the chain thread waited for the full queue
+};
+
 class mongo_db_plugin : public plugin<mongo_db_plugin> {
 public:
     APPBASE_PLUGIN_REQUIRES((chain_plugin))
@@ -29,12 +40,18 @@ public:
     void plugin_shutdown();
 
 public:
+    mongo_db_stats get_stats() const;
+
     fc::flat_set<std::string> get_tokens_by_public_keys(const std::vector<public_key_type>& pkeys);
     fc::flat_set<std::string> get_domains_by_public_keys(const std::vector<public_key_type>& pkeys);
     fc::flat_set<std::string> get_groups_by_public_keys(const std::vector<public_key_type>& pkeys);
 
 private:
-    mongo_db_plugin_impl_ptr my;
+    mongo_db_plugin_impl_ptr    my;
+    mutable boost::shared_mutex my_mutex;  // queries from http threads hold it shared, so `my` is kept until they're done
 };
 
 }  // namespace evt
+
+FC_REFLECT(evt::mongo_db_stats, (max_queue_size)(queued_blocks)(queued_transactions)(last_queued_block_num)
+                                (last_written_block_num)(lag_blocks)(blocked_time_ms));
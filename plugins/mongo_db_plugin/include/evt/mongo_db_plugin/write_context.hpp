@@ -0,0 +1,127 @@
+/**
+ *  @file
+ *  @copyright defined in evt/LICENSE.txt
+ */
+#pragma once
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fc/log/logger.hpp>
+#include <mongocxx/bulk_write.hpp>
+#include <mongocxx/collection.hpp>
+#include <mongocxx/database.hpp>
+#include <mongocxx/pool.hpp>
+#include <evt/chain/thread_pool.hpp>
+
+namespace evt {
+
+/**
+ * Pending writes of one collection, they're sent to MongoDB in one bulk write when committed.
+ * Writes which depend on the previous ones (updates of the same document) need an ordered bulk,
+ * collections which are only inserted into use an unordered one.
+ */
+class bulk_writer {
+public:
+    bulk_writer(std::string collection, bool ordered)
+        : collection_(std::move(collection))
+        , ordered_(ordered)
+        , count_(0) {
+        reset();
+    }
+
+public:
+    void
+    append(const mongocxx::model::write& op) {
+        bulk_->append(op);
+        count_++;
+    }
+
+    size_t
+    size() const { return count_; }
+
+    void
+    commit(const mongocxx::database& db) {
+        if(count_ == 0) {
+            return;
+        }
+        try {
+            if(!db[collection_].bulk_write(*bulk_)) {
+                elog("Bulk write of ${n} documents failed for collection: ${c}", ("n", count_)("c", collection_));
+            }
+        }
+        catch(std::exception& e) {
+            elog("Bulk write of ${n} documents failed for collection: ${c}, ${e}", ("n", count_)("c", collection_)("e", e.what()));
+        }
+        reset();
+    }
+
+private:
+    void
+    reset() {
+        mongocxx::options::bulk_write opts;
+        opts.ordered(ordered_);
+        bulk_  = std::make_unique<mongocxx::bulk_write>(opts);
+        count_ = 0;
+    }
+
+private:
+    std::string                           collection_;
+    bool                                  ordered_;
+    size_t                                count_;
+    std::unique_ptr<mongocxx::bulk_write> bulk_;
+};
+
+/**
+ * Writes of all the collections accumulated for a batch of blocks and transactions
+ */
+struct write_context {
+    write_context()
+        : blocks("Blocks", true)
+        , trans("Transactions", true)
+        , actions("Actions", false)
+        , action_traces("ActionTraces", false)
+        , domains("Domains", true)
+        , tokens("Tokens", true)
+        , groups("Groups", true)
+        , accounts("Accounts", true) {}
+
+    size_t
+    size() const {
+        return blocks.size() + trans.size() + actions.size() + action_traces.size()
+            + domains.size() + tokens.size() + groups.size() + accounts.size();
+    }
+
+    /**
+     * Collections are written in parallel by `writers`, each with its own client from `pool`.
+     * Writes of one collection are always done by one bulk in order, and it returns after all
+     * the collections are written, so the writes of one entity never overtake the previous ones.
+     */
+    void
+    commit(mongocxx::pool& pool, const std::string& db_name, chain::thread_pool& writers) {
+        auto futures = std::vector<std::future<void>>();
+        for(auto w : {&blocks, &trans, &actions, &action_traces, &domains, &tokens, &groups, &accounts}) {
+            if(w->size() == 0) {
+                continue;
+            }
+            futures.emplace_back(writers.post([&pool, &db_name, w] {
+                auto client = pool.acquire();
+                w->commit((*client)[db_name]);
+            }));
+        }
+        for(auto& f : futures) {
+            f.get();
+        }
+    }
+
+    bulk_writer blocks;
+    bulk_writer trans;
+    bulk_writer actions;
+    bulk_writer action_traces;
+    bulk_writer domains;
+    bulk_writer tokens;
+    bulk_writer groups;
+    bulk_writer accounts;
+};
+
+}  // namespace evt
@@ -3,8 +3,10 @@
  *  @copyright defined in evt/LICENSE.txt
  */
 #include <evt/mongo_db_plugin/mongo_db_plugin.hpp>
+#include <evt/mongo_db_plugin/bson_serializer.hpp>
 #include <evt/mongo_db_plugin/evt_interpreter.hpp>
 #include <evt/mongo_db_plugin/wallet_query.hpp>
+#include <evt/mongo_db_plugin/write_context.hpp>
 
 #include <queue>
 #include <tuple>
@@ -30,6 +32,7 @@
 
 #include <mongocxx/client.hpp>
 #include <mongocxx/instance.hpp>
+#include <mongocxx/pool.hpp>
 
 namespace fc {
 class variant;
@@ -54,38 +57,49 @@ public:
     void applied_block(const block_state_ptr&);
     void applied_irreversible_block(const block_state_ptr&);
     void applied_transaction(const transaction_trace_ptr&);
-    void process_block(const signed_block&);
-    void _process_block(const signed_block&);
-    void process_irreversible_block(const signed_block&);
-    void _process_irreversible_block(const signed_block&);
-    void process_transaction(const transaction_trace&);
-    void _process_transaction(const transaction_trace&);
+    void process_block(const signed_block&, write_context&);
+    void _process_block(const signed_block&, write_context&);
+    void process_irreversible_block(const signed_block&, write_context&);
+    void _process_irreversible_block(const signed_block&, write_context&);
+    void process_transaction(const transaction_trace&, write_context&);
+    void _process_transaction(const transaction_trace&, write_context&);
 
     void init();
     void wipe_database();
 
+    template <typename Queue, typename Entry>
+    void queue(Queue& queue, Entry&& e);
+    void commit(write_context& write_ctx, uint32_t block_num);
+
     static abi_def eos_abi;  // cached for common use
     abi_serializer evt_api;
 
     bool configured{false};
     bool wipe_database_on_startup{false};
 
-    std::string        db_name;
-    mongocxx::instance mongo_inst;
-    mongocxx::client   mongo_conn;
+    std::string                     db_name;
+    mongocxx::instance              mongo_inst;
+    mongocxx::client                mongo_conn;
+    std::unique_ptr<mongocxx::pool> mongo_pool;  // clients of the writer threads
+    std::unique_ptr<thread_pool>    writers;     // write collections in parallel
 
     evt_interpreter    interpreter;
 
     size_t                            queue_size = 0;
+    size_t                            batch_size = 0;  // max number of documents written in one batch
     size_t                            processed  = 0;
     std::deque<inblock_ptr>           block_state_queue;
     std::deque<transaction_trace_ptr> transaction_trace_queue;
 
+    boost::atomic<uint32_t> last_queued_block_num{0};
+    boost::atomic<uint32_t> last_written_block_num{0};
+    boost::atomic<uint64_t> blocked_time_us{0};  // total time the chain thread waited for the full queues
+
     boost::mutex              mtx;
     boost::condition_variable condition;
+    boost::condition_variable queue_condition;  // notified when the queues are taken by consumer
     boost::thread             consume_thread;
     boost::atomic<bool>       done{false};
-    boost::atomic<bool>       startup{true};
 
     channels::accepted_block::channel_type::handle      accepted_block_subscription;
     channels::irreversible_block::channel_type::handle  irreversible_block_subscription;
@@ -115,10 +129,7 @@ const std::string mongo_db_plugin_impl::accounts_col      = "Accounts";
 void
 mongo_db_plugin_impl::applied_irreversible_block(const block_state_ptr& bsp) {
     try {
-        boost::mutex::scoped_lock lock(mtx);
-        block_state_queue.push_back(std::make_tuple(bsp, true));
-        lock.unlock();
-        condition.notify_one();
+        queue(block_state_queue, std::make_tuple(bsp, true));
     }
     catch(fc::exception& e) {
         elog("FC Exception while applied_irreversible_block ${e}", ("e", e.to_string()));
@@ -134,10 +145,8 @@ mongo_db_plugin_impl::applied_irreversible_block(const block_state_ptr& bsp) {
 void
 mongo_db_plugin_impl::applied_block(const block_state_ptr& bsp) {
     try {
-        boost::mutex::scoped_lock lock(mtx);
-        block_state_queue.emplace_back(std::make_tuple(bsp, false));
-        lock.unlock();
-        condition.notify_one();
+        queue(block_state_queue, std::make_tuple(bsp, false));
+        last_queued_block_num = bsp->block_num;
     }
     catch(fc::exception& e) {
         elog("FC Exception while applied_block ${e}", ("e", e.to_string()));
@@ -153,16 +162,8 @@ mongo_db_plugin_impl::applied_block(const block_state_ptr& bsp) {
 void
 mongo_db_plugin_impl::applied_transaction(const transaction_trace_ptr& ttp) {
     try {
-        if(startup) {
-            // on startup we don't want to queue, instead push back on caller
-            process_transaction(*ttp);
-        }
-        else {
-            boost::mutex::scoped_lock lock(mtx);
-            transaction_trace_queue.emplace_back(ttp);
-            lock.unlock();
-            condition.notify_one();
-        }
+        // consumer runs from plugin_initialize, traces of replay are batched the same as the blocks
+        queue(transaction_trace_queue, ttp);
     }
     catch(fc::exception& e) {
         elog("FC Exception while applied_transaction ${e}", ("e", e.to_string()));
@@ -175,9 +176,44 @@ mongo_db_plugin_impl::applied_transaction(const transaction_trace_ptr& ttp) {
     }
 }
 
+template <typename Queue, typename Entry>
+void
+mongo_db_plugin_impl::queue(Queue& queue, Entry&& e) {
+    boost::mutex::scoped_lock lock(mtx);
+    if(block_state_queue.size() + transaction_trace_queue.size() >= queue_size) {
+        // queues are full, block the chain thread until consumer takes them
+        auto start = fc::time_point::now();
+        condition.notify_one();
+        while(block_state_queue.size() + transaction_trace_queue.size() >= queue_size && !done) {
+            queue_condition.wait(lock);
+        }
+        blocked_time_us += (fc::time_point::now() - start).count();
+    }
+    queue.emplace_back(std::forward<Entry>(e));
+    lock.unlock();
+    condition.notify_one();
+}
+
+void
+mongo_db_plugin_impl::commit(write_context& write_ctx, uint32_t block_num) {
+    write_ctx.commit(*mongo_pool, db_name, *writers);
+    if(block_num > 0) {
+        last_written_block_num = block_num;
+    }
+}
+
 void
 mongo_db_plugin_impl::consume_queues() {
     try {
+        // documents of blocks and transactions are accumulated and written in bulks
+        auto write_ctx    = write_context();
+        auto block_num    = 0u;
+        auto commit_batch = [&] {
+            if(write_ctx.size() >= batch_size) {
+                commit(write_ctx, block_num);
+            }
+        };
+
         while(true) {
             boost::mutex::scoped_lock lock(mtx);
             while(block_state_queue.empty() && transaction_trace_queue.empty() && !done) {
@@ -197,9 +233,10 @@ mongo_db_plugin_impl::consume_queues() {
                 transaction_trace_queue.clear();
             }
             lock.unlock();
+            queue_condition.notify_all();
 
             // warn if queue size greater than 75%
-            if(bsize > (queue_size * 0.75) || tsize > (queue_size * 0.75)) {
+            if(bsize + tsize > (queue_size * 0.75)) {
                 wlog("queue size: ${q}", ("q", bsize + tsize + 1));
             }
             else if(done) {
@@ -212,21 +249,27 @@ mongo_db_plugin_impl::consume_queues() {
             while(!bqueue.empty()) {
                 const auto& b = bqueue.front();
                 if(std::get<IsIrreversible>(b)) {
-                    process_irreversible_block(*(std::get<BlockPtr>(b)->block));
+                    process_irreversible_block(*(std::get<BlockPtr>(b)->block), write_ctx);
                 }
                 else {
-                    process_block(*(std::get<BlockPtr>(b)->block));
+                    process_block(*(std::get<BlockPtr>(b)->block), write_ctx);
+                    block_num = std::get<BlockPtr>(b)->block_num;
                 }
                 bqueue.pop_front();
+                commit_batch();
             }
 
             // process transaction traces
             while(!tqueue.empty()) {
                 const auto& t = tqueue.front();
-                process_transaction(*t);
+                process_transaction(*t, write_ctx);
                 tqueue.pop_front();
+                commit_batch();
             }
 
+            // queues are drained, write the remains
+            commit(write_ctx, block_num);
+
             if(bsize == 0 && tsize == 0 && done) {
                 break;
             }
@@ -246,30 +289,6 @@ mongo_db_plugin_impl::consume_queues() {
 
 namespace __internal {
 
-auto
-find_transaction(mongocxx::collection& transactions, const string& id) {
-    using bsoncxx::builder::stream::document;
-    document find_trans{};
-    find_trans << "trx_id" << id;
-    auto transaction = transactions.find_one(find_trans.view());
-    if(!transaction) {
-        FC_THROW("Unable to find transaction ${id}", ("id", id));
-    }
-    return *transaction;
-}
-
-auto
-find_block(mongocxx::collection& blocks, const string& id) {
-    using bsoncxx::builder::stream::document;
-    document find_block{};
-    find_block << "block_id" << id;
-    auto block = blocks.find_one(find_block.view());
-    if(!block) {
-        FC_THROW("Unable to find block ${id}", ("id", id));
-    }
-    return *block;
-}
-
 void
 add_data(bsoncxx::builder::basic::document& msg_doc,
          const chain::action&               msg,
@@ -277,17 +296,9 @@ add_data(bsoncxx::builder::basic::document& msg_doc,
     using bsoncxx::builder::basic::kvp;
     try {
         auto& abis = evt_api;
-        auto v     = abis.binary_to_variant(abis.get_action_type(msg.name), msg.data);
-        auto json  = fc::json::to_string(v);
-        try {
-            const auto& value = bsoncxx::from_json(json);
-            msg_doc.append(kvp("data", value));
-            return;
-        }
-        catch(std::exception& e) {
-            elog("Unable to convert EVT JSON to MongoDB JSON: ${e}", ("e", e.what()));
-            elog("  EVT JSON: ${j}", ("j", json));
-        }
+        auto  data = bson_serializer::binary_to_bson(abis, abis.get_action_type(msg.name), msg.data);
+        msg_doc.append(kvp("data", data));
+        return;
     }
     catch(fc::exception& e) {
         elog("Unable to convert action.data to ABI: ${n}, what: ${e}", ("n", msg.name)("e", e.to_string()));
@@ -325,14 +336,14 @@ verify_no_blocks(mongocxx::collection& blocks) {
 }  // namespace __internal
 
 void
-mongo_db_plugin_impl::process_irreversible_block(const signed_block& block) {
+mongo_db_plugin_impl::process_irreversible_block(const signed_block& block, write_context& write_ctx) {
     try {
         if(block.block_num() == 1) {
             // genesis block will not trigger on_block event
             // add it manually
-            _process_block(block); 
+            _process_block(block, write_ctx);
         }
-        _process_irreversible_block(block);
+        _process_irreversible_block(block, write_ctx);
     }
     catch(fc::exception& e) {
         elog("FC Exception while processing irreversible block ${e}", ("e", e.to_string()));
@@ -346,9 +357,9 @@ mongo_db_plugin_impl::process_irreversible_block(const signed_block& block) {
 }
 
 void
-mongo_db_plugin_impl::process_block(const signed_block& block) {
+mongo_db_plugin_impl::process_block(const signed_block& block, write_context& write_ctx) {
     try {
-        _process_block(block);
+        _process_block(block, write_ctx);
     }
     catch(fc::exception& e) {
         elog("FC Exception while processing block ${e}", ("e", e.to_string()));
@@ -362,10 +373,10 @@ mongo_db_plugin_impl::process_block(const signed_block& block) {
 }
 
 void
-mongo_db_plugin_impl::process_transaction(const transaction_trace& trace) {
+mongo_db_plugin_impl::process_transaction(const transaction_trace& trace, write_context& write_ctx) {
     try {
-        _process_transaction(trace);
-        interpreter.process_trx(trace);
+        _process_transaction(trace, write_ctx);
+        interpreter.process_trx(trace, write_ctx);
     }
     catch(fc::exception& e) {
         elog("FC Exception while processing transaction trace ${e}", ("e", e.to_string()));
@@ -379,21 +390,13 @@ mongo_db_plugin_impl::process_transaction(const transaction_trace& trace) {
 }
 
 void
-mongo_db_plugin_impl::_process_block(const signed_block& block) {
+mongo_db_plugin_impl::_process_block(const signed_block& block, write_context& write_ctx) {
     using namespace __internal;
     using namespace bsoncxx::types;
     using namespace bsoncxx::builder;
     using bsoncxx::builder::basic::kvp;
 
-    mongocxx::options::bulk_write bulk_opts;
-    bulk_opts.ordered(false);
-
-    auto bulk_trans = mongocxx::bulk_write(bulk_opts);
-    auto bulk_acts  = mongocxx::bulk_write(bulk_opts);
-
-    auto blocks        = mongo_conn[db_name][blocks_col];         // Blocks
-    auto trans         = mongo_conn[db_name][trans_col];          // Transactions
-    auto actions       = mongo_conn[db_name][actions_col];        // Actions
+    auto blocks = mongo_conn[db_name][blocks_col];  // Blocks
 
     auto       block_doc         = bsoncxx::builder::basic::document{};
     const auto block_id          = block.id();
@@ -426,13 +429,10 @@ mongo_db_plugin_impl::_process_block(const signed_block& block) {
                      kvp("pending", b_bool{true}));
     block_doc.append(kvp("created_at", b_date{now}));
 
-    if(!blocks.insert_one(block_doc.view())) {
-        elog("Failed to insert block ${bid}", ("bid", block_id));
-    }
+    write_ctx.blocks.append(mongocxx::model::insert_one{block_doc.view()});
 
-    int32_t act_num          = 0;
-    bool    actions_to_write = false;
-    auto    process_action   = [&](const std::string& trans_id_str, const chain::action& msg) -> auto {
+    int32_t act_num        = 0;
+    auto    process_action = [&](const std::string& trans_id_str, const chain::action& msg) -> auto {
         auto msg_oid = bsoncxx::oid{};
         auto msg_doc = bsoncxx::builder::basic::document{};
         msg_doc.append(kvp("_id", b_oid{msg_oid}),
@@ -444,13 +444,11 @@ mongo_db_plugin_impl::_process_block(const signed_block& block) {
         add_data(msg_doc, msg, evt_api);
         msg_doc.append(kvp("created_at", b_date{now}));
         mongocxx::model::insert_one insert_msg{msg_doc.view()};
-        bulk_acts.append(insert_msg);
-        actions_to_write = true;
+        write_ctx.actions.append(insert_msg);
         return msg_oid;
     };
 
     int32_t trx_num = 0;
-    bool    transactions_in_block = false;
 
     auto process_trx = [&](const chain::transaction& trx) -> auto {
         auto       txn_oid      = bsoncxx::oid{};
@@ -475,7 +473,6 @@ mongo_db_plugin_impl::_process_block(const signed_block& block) {
                 act_num++;
             }
         }
-        transactions_in_block = true;
         return doc;
     };
 
@@ -490,28 +487,15 @@ mongo_db_plugin_impl::_process_block(const signed_block& block) {
             }
         }));
         mongocxx::model::insert_one insert_op{doc.view()};
-        bulk_trans.append(insert_op);
+        write_ctx.trans.append(insert_op);
         ++trx_num;
     }
 
-    if(actions_to_write) {
-        auto result = actions.bulk_write(bulk_acts);
-        if(!result) {
-            elog("Bulk actions insert failed for block: ${bid}", ("bid", block_id));
-        }
-    }
-    if(transactions_in_block) {
-        auto result = trans.bulk_write(bulk_trans);
-        if(!result) {
-            elog("Bulk transaction insert failed for block: ${bid}", ("bid", block_id));
-        }
-    }
-
     ++processed;
 }
 
 void
-mongo_db_plugin_impl::_process_irreversible_block(const signed_block& block) {
+mongo_db_plugin_impl::_process_irreversible_block(const signed_block& block, write_context& write_ctx) {
     using namespace __internal;
     using namespace bsoncxx::types;
     using namespace bsoncxx::builder;
@@ -521,40 +505,35 @@ mongo_db_plugin_impl::_process_irreversible_block(const signed_block& block) {
     using bsoncxx::builder::stream::finalize;
     using bsoncxx::builder::stream::open_document;
 
-    auto blocks = mongo_conn[db_name][blocks_col];  // Blocks
-    auto trans  = mongo_conn[db_name][trans_col];   // Transactions
-
     const auto block_id     = block.id();
     const auto block_id_str = block_id.str();
 
     auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
         std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
 
-    auto ir_block = find_block(blocks, block_id_str);
-
+    // block and transactions are updated by their ids, the bulks are ordered so the inserts are done before
     document update_block{};
     update_block << "$set" << open_document << "pending" << b_bool{false}
                  << "updated_at" << b_date{now}
                  << close_document;
 
-    blocks.update_one(document{} << "_id" << ir_block.view()["_id"].get_oid() << finalize, update_block.view());
+    write_ctx.blocks.append(mongocxx::model::update_one{document{} << "block_id" << block_id_str << finalize, update_block.view()});
 
     for(const auto& trx_receipt : block.transactions) {
         auto trans_id_str = trx_receipt.trx.id().str();
-        auto ir_trans     = find_transaction(trans, trans_id_str);
 
         document update_trans{};
         update_trans << "$set" << open_document << "pending" << b_bool{false}
                      << "updated_at" << b_date{now}
                      << close_document;
 
-        trans.update_one(document{} << "_id" << ir_trans.view()["_id"].get_oid() << finalize,
-                         update_trans.view());
+        write_ctx.trans.append(mongocxx::model::update_one{document{} << "trx_id" << trans_id_str << finalize,
+                                                           update_trans.view()});
     }
 }
 
 void
-mongo_db_plugin_impl::_process_transaction(const transaction_trace& trace) {
+mongo_db_plugin_impl::_process_transaction(const transaction_trace& trace, write_context& write_ctx) {
     using namespace bsoncxx::types;
     using namespace bsoncxx::builder;
     using bsoncxx::builder::basic::kvp;
@@ -562,11 +541,8 @@ mongo_db_plugin_impl::_process_transaction(const transaction_trace& trace) {
     auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
     std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
 
-    auto action_traces          = mongo_conn[db_name][action_traces_col];  // ActionTraces
-    bool action_traces_to_write = false;
-    auto seq_num                = 0;
-    auto process_action_trace   = [&](const std::string&       trans_id_str,
-                                    mongocxx::bulk_write&      bulk_acts,
+    auto seq_num              = 0;
+    auto process_action_trace = [&](const std::string&         trans_id_str,
                                     const chain::action_trace& act) {
         auto act_oid = bsoncxx::oid{};
         auto act_doc = bsoncxx::builder::basic::document{};
@@ -577,27 +553,14 @@ mongo_db_plugin_impl::_process_transaction(const transaction_trace& trace) {
                        kvp("console", act.console));
         act_doc.append(kvp("created_at", b_date{now}));
         mongocxx::model::insert_one insert_act{act_doc.view()};
-        bulk_acts.append(insert_act);
-        action_traces_to_write = true;
+        write_ctx.action_traces.append(insert_act);
     };
 
     auto trx_id_str = trace.id.str();
-
-    mongocxx::options::bulk_write bulk_opts;
-    bulk_opts.ordered(false);
-
-    auto bulk_acts  = mongocxx::bulk_write(bulk_opts);
     for(auto& at : trace.action_traces) {
-        process_action_trace(trx_id_str, bulk_acts, at);
+        process_action_trace(trx_id_str, at);
         seq_num++;
     }
-
-    if(action_traces_to_write) {
-        auto result = action_traces.bulk_write(bulk_acts);
-        if(!result) {
-            elog("Bulk action traces insert failed for transaction: ${tid}", ("tid", trx_id_str));
-        }
-    }
 }
 
 mongo_db_plugin_impl::mongo_db_plugin_impl()
@@ -690,9 +653,6 @@ mongo_db_plugin_impl::init() {
         accounts.create_index(bsoncxx::from_json(R"xxx({ "name" : 1 })xxx"));
     }
 
-    // initilize evt interpreter
-    interpreter.initialize_db(mongo_conn[db_name]);
-
     evt_api = abi_serializer(contracts::evt_contract_abi());
 
     // connect callbacks to channel
@@ -718,7 +678,9 @@ mongo_db_plugin::~mongo_db_plugin() {
 void
 mongo_db_plugin::set_program_options(options_description& cli, options_description& cfg) {
     cfg.add_options()
-        ("mongodb-queue-size,q", bpo::value<uint>()->default_value(256), "The queue size between evtd and MongoDB plugin thread.")
+        ("mongodb-queue-size,q", bpo::value<uint>()->default_value(256), "The queue size between evtd and MongoDB plugin thread, chain thread waits when the queue is full.")
+        ("mongodb-batch-size", bpo::value<uint>()->default_value(5000), "The maximum number of documents written to MongoDB in one batch of bulk writes.")
+        ("mongodb-writer-threads", bpo::value<uint>()->default_value(4), "The number of threads writing the collections to MongoDB in parallel.")
         ("mongodb-uri,m", bpo::value<std::string>(), "MongoDB URI connection string, see: https://docs.mongodb.com/master/reference/connection-string/."
                                                      " If not specified then plugin is disabled. Default database 'EVT' is used if not specified in URI.")
         ;
@@ -742,6 +704,9 @@ mongo_db_plugin::plugin_initialize(const variables_map& options) {
             auto size      = options.at("mongodb-queue-size").as<uint>();
             my->queue_size = size;
         }
+        if(options.count("mongodb-batch-size")) {
+            my->batch_size = options.at("mongodb-batch-size").as<uint>();
+        }
 
         std::string uri_str = options.at("mongodb-uri").as<std::string>();
         ilog("connecting to ${u}", ("u", uri_str));
@@ -750,11 +715,16 @@ mongo_db_plugin::plugin_initialize(const variables_map& options) {
         if(my->db_name.empty())
             my->db_name = "EVT";
         my->mongo_conn = mongocxx::client{uri};
+        my->mongo_pool = std::make_unique<mongocxx::pool>(uri);
+        my->writers    = std::make_unique<thread_pool>(options.at("mongodb-writer-threads").as<uint>());
 
         if(my->wipe_database_on_startup) {
             my->wipe_database();
         }
         my->init();
+
+        // consumer starts before replaying, so the queues are bounded during replay as well
+        my->consume_thread = boost::thread([this] { my->consume_queues(); });
     }
     else {
         wlog("evt::mongo_db_plugin configured, but no --mongodb-uri specified.");
@@ -766,34 +736,65 @@ void
 mongo_db_plugin::plugin_startup() {
     if(my->configured) {
         ilog("starting db plugin");
-
-        my->consume_thread = boost::thread([this] { my->consume_queues(); });
-
-        // chain_controller is created and has resynced or replayed if needed
-        my->startup = false;
     }
 }
 
 void
 mongo_db_plugin::plugin_shutdown() {
+    // it may be shut down before http_plugin, wait for the queries running on http threads
+    boost::unique_lock<boost::shared_mutex> lock(my_mutex);
     my.reset();
 }
 
+mongo_db_stats
+mongo_db_plugin::get_stats() const {
+    boost::shared_lock<boost::shared_mutex> lock(my_mutex);
+    FC_ASSERT(my, "MongoDB plugin is shut down");
+
+    auto stats = mongo_db_stats();
+    {
+        boost::mutex::scoped_lock lock(my->mtx);
+        stats.queued_blocks       = my->block_state_queue.size();
+        stats.queued_transactions = my->transaction_trace_queue.size();
+    }
+    stats.max_queue_size         = my->queue_size;
+    stats.last_queued_block_num  = my->last_queued_block_num;
+    stats.last_written_block_num = my->last_written_block_num;
+    stats.lag_blocks             = stats.last_queued_block_num > stats.last_written_block_num
+                                       ? stats.last_queued_block_num - stats.last_written_block_num
+                                       : 0;
+    stats.blocked_time_ms = my->blocked_time_us / 1000;
+    return stats;
+}
+
 fc::flat_set<std::string>
 mongo_db_plugin::get_tokens_by_public_keys(const std::vector<public_key_type>& pkeys) {
-    auto query = wallet_query(my->mongo_conn[my->db_name]);
+    // called from http threads, every query uses its own client
+    boost::shared_lock<boost::shared_mutex> lock(my_mutex);
+    FC_ASSERT(my, "MongoDB plugin is shut down");
+
+    auto client = my->mongo_pool->acquire();
+    auto query  = wallet_query((*client)[my->db_name]);
     return query.get_tokens_by_public_keys(pkeys);
 }
 
 fc::flat_set<std::string>
 mongo_db_plugin::get_domains_by_public_keys(const std::vector<public_key_type>& pkeys) {
-    auto query = wallet_query(my->mongo_conn[my->db_name]);
+    boost::shared_lock<boost::shared_mutex> lock(my_mutex);
+    FC_ASSERT(my, "MongoDB plugin is shut down");
+
+    auto client = my->mongo_pool->acquire();
+    auto query  = wallet_query((*client)[my->db_name]);
     return query.get_domains_by_public_keys(pkeys);
 }
 
 fc::flat_set<std::string>
 mongo_db_plugin::get_groups_by_public_keys(const std::vector<public_key_type>& pkeys) {
-    auto query = wallet_query(my->mongo_conn[my->db_name]);
+    boost::shared_lock<boost::shared_mutex> lock(my_mutex);
+    FC_ASSERT(my, "MongoDB plugin is shut down");
+
+    auto client = my->mongo_pool->acquire();
+    auto query  = wallet_query((*client)[my->db_name]);
     return query.get_domains_by_public_keys(pkeys);
 }
 
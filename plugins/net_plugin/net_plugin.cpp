@@ -10,6 +10,7 @@
 #include <evt/chain/exceptions.hpp>
 #include <evt/chain/multi_index_includes.hpp>
 #include <evt/chain/plugin_interface.hpp>
+#include <evt/chain/thread_pool.hpp>
 
 #include <evt/net_plugin/protocol.hpp>
 #include <evt/producer_plugin/producer_plugin.hpp>
@@ -28,7 +29,10 @@
 #include <boost/asio/ip/host_name.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/intrusive/set.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
 
 using namespace evt::chain::plugin_interface::compat;
 
@@ -63,6 +67,35 @@ using socket_ptr = std::shared_ptr<tcp::socket>;
 
 using net_message_ptr = shared_ptr<net_message>;
 
+// serialized message with its size header, immutable once packed so it can be shared by the write queues of all connections
+using send_buffer_ptr = std::shared_ptr<const vector<char>>;
+
+template <typename T>
+send_buffer_ptr
+create_send_buffer(const T& m) {
+    // same as packing a net_message which holds `m`, but without copying `m` into the variant
+    auto     which        = fc::unsigned_int(net_message::tag<T>::value);
+    uint32_t payload_size = fc::raw::pack_size(which) + fc::raw::pack_size(m);
+
+    auto buff = std::make_shared<vector<char>>(sizeof(payload_size) + payload_size);
+    auto ds   = fc::datastream<char*>(buff->data(), buff->size());
+    ds.write(reinterpret_cast<char*>(&payload_size), sizeof(payload_size));
+    fc::raw::pack(ds, which);
+    fc::raw::pack(ds, m);
+    return buff;
+}
+
+send_buffer_ptr
+create_send_buffer(const net_message& m) {
+    uint32_t payload_size = fc::raw::pack_size(m);
+
+    auto buff = std::make_shared<vector<char>>(sizeof(payload_size) + payload_size);
+    auto ds   = fc::datastream<char*>(buff->data(), buff->size());
+    ds.write(reinterpret_cast<char*>(&payload_size), sizeof(payload_size));
+    fc::raw::pack(ds, m);
+    return buff;
+}
+
 template <typename I>
 std::string
 itoh(I n, size_t hlen = sizeof(I) << 1) {
@@ -79,7 +112,7 @@ struct node_transaction_state {
                                   /// Expires increased while the txn is
                                   /// "in flight" to anoher peer
     packed_transaction packed_txn;
-    vector<char>       serialized_txn;  /// the received raw bundle
+    send_buffer_ptr    serialized_txn;  /// the received raw bundle
     uint32_t           block_num  = 0;  /// block transaction was included in
     uint32_t           true_block = 0;  /// used to reset block_uum when request is 0
     uint16_t           requests   = 0;  /// the number of "in flight" requests for this txn
@@ -92,14 +125,8 @@ struct update_entry {
 
     void
     operator()(node_transaction_state& nts) {
-        nts.packed_txn = txn;
-        net_message msg(txn);
-        uint32_t    packsiz = fc::raw::pack_size(msg);
-        uint32_t    bufsiz  = packsiz + sizeof(packsiz);
-        nts.serialized_txn.resize(bufsiz);
-        fc::datastream<char*> ds(nts.serialized_txn.data(), bufsiz);
-        ds.write(reinterpret_cast<char*>(&packsiz), sizeof(packsiz));
-        fc::raw::pack(ds, msg);
+        nts.packed_txn     = txn;
+        nts.serialized_txn = create_send_buffer(txn);
     }
 };
 
@@ -197,6 +224,8 @@ public:
 
     shared_ptr<tcp::resolver> resolver;
 
+    unique_ptr<chain::thread_pool> net_workers;  ///< decodes and prechecks the received messages
+
     channels::transaction_ack::channel_type::handle incoming_transaction_ack_subscription;
 
     void connect(connection_ptr c);
@@ -210,6 +239,8 @@ public:
 
     template <typename VerifierFunc>
     void send_all(const net_message& msg, VerifierFunc verify);
+    template <typename VerifierFunc>
+    void send_all(const send_buffer_ptr& buffer, VerifierFunc verify);
 
     void accepted_block_header(const block_state_ptr&);
     void accepted_block(const block_state_ptr&);
@@ -310,6 +341,13 @@ constexpr auto     def_conn_retry_wait     = 30;
 constexpr auto     def_txn_expire_wait     = std::chrono::seconds(3);
 constexpr auto     def_resp_expected_wait  = std::chrono::seconds(5);
 constexpr auto     def_sync_fetch_span     = 100;
+constexpr auto     def_net_threads         = 2;
+constexpr uint32_t def_max_read_bytes      = def_send_buffer_size * 4;  // bytes of one peer queued for decoding before reading pauses
+constexpr uint32_t def_max_read_messages   = 1000;                      // messages of one peer queued for decoding before reading pauses
+constexpr auto     def_max_block_origins   = 1024;
+constexpr auto     def_max_block_buffers   = def_send_buffer_size * 8;  // total bytes of raw block messages kept with the origins
+constexpr auto     def_max_trx_origins     = 100000;
+constexpr auto     def_origin_expire_sec   = 120;
 constexpr uint32_t def_max_just_send       = 1500;  // roughly 1 "mtu"
 constexpr bool     large_msg_notify        = false;
 
@@ -473,10 +511,16 @@ public:
     socket_ptr              socket;
 
     fc::message_buffer<1024 * 1024> pending_message_buffer;
-    vector<char>                    blk_buffer;
+    send_buffer_ptr                 blk_buffer;  // raw message of the last received block, used to relay it
+
+    unique_ptr<boost::asio::io_service::strand> strand;            // decodes the messages of this peer in order on the net workers
+    uint32_t                                    read_session = 0;  // increased on close, messages decoded for previous session are dropped
+    uint32_t                                    queued_bytes = 0;     // bytes queued on the strand and not handled yet
+    uint32_t                                    queued_messages = 0;  // messages queued on the strand and not handled yet
+    bool                                        read_paused = false;  // reading stopped until the queued messages drain
 
     struct queued_write {
-        std::shared_ptr<vector<char>>                               buff;
+        send_buffer_ptr                                             buff;
         std::function<void(boost::system::error_code, std::size_t)> callback;
     };
     deque<queued_write>                   write_queue;
@@ -566,6 +610,7 @@ public:
 
     void enqueue(transaction_id_type id);
     void enqueue(const net_message& msg, bool trigger_send = true);
+    void enqueue_buffer(const send_buffer_ptr& send_buffer, bool trigger_send = true, go_away_reason close_after_send = no_reason);
     void cancel_sync(go_away_reason);
     void flush_queues();
     bool enqueue_sync_block();
@@ -577,8 +622,8 @@ public:
     void sync_timeout(boost::system::error_code ec);
     void fetch_timeout(boost::system::error_code ec);
 
-    void queue_write(std::shared_ptr<vector<char>> buff,
-                     bool                          trigger_send,
+    void queue_write(const send_buffer_ptr& buff,
+                     bool                   trigger_send,
                      std::function<void(boost::system::error_code, std::size_t)>
                          callback);
     void do_queue_write();
@@ -594,6 +639,26 @@ public:
        */
     bool process_next_message(net_plugin_impl& impl, uint32_t message_length);
 
+    /** \brief Decode the next message from the pending message buffer on the net workers
+       *
+       * Same as process_next_message, but the message is copied out of the
+       * pending_message_buffer and unpacked on the strand of this connection.
+       * Messages passing the prechecks are handled on the main thread in the
+       * order they were received.
+       */
+    void queue_next_message(net_plugin_impl& impl, uint32_t message_length);
+
+    /** \brief Whether too many messages are queued to keep reading from the socket
+       *
+       * Reading is paused by the read loop once the limits are reached and
+       * resumed by finish_queued_message when the backlog drains below them.
+       */
+    bool read_backlog_full() const;
+
+    /** \brief Called on the main thread when a queued message is handled or dropped
+       */
+    void finish_queued_message(net_plugin_impl& impl, uint32_t message_size);
+
     bool add_peer_block(const peer_block_state &pbs);
 };
 
@@ -656,32 +721,71 @@ public:
         block_id_type id;
         bool          local_retry;
     };
-    vector<block_request>       req_blks;
-    vector<transaction_id_type> req_trx;
+    vector<block_request> req_blks;
 
     struct block_origin {
-        block_id_type  id;
-        connection_ptr origin;
+        block_id_type   id;
+        connection_ptr  origin;
+        send_buffer_ptr buffer;  // raw message received from origin
+        time_point      received;
     };
 
     struct transaction_origin {
         transaction_id_type id;
         connection_ptr      origin;
+        time_point          received;
     };
 
-    vector<block_origin>       received_blocks;
-    vector<transaction_origin> received_transactions;
+    struct transaction_request {
+        transaction_id_type id;
+        time_point          received;
+    };
+
+    struct by_insertion;
+
+    // entries are found by hash of id and expired in the order they are inserted
+    template <typename T, typename Id>
+    using origin_index = multi_index_container<
+        T,
+        indexed_by<
+            bmi::hashed_unique<
+                tag<by_id>,
+                member<T, Id, &T::id>,
+                std::hash<Id>>,
+            bmi::sequenced<
+                tag<by_insertion>>>>;
+
+    origin_index<block_origin, block_id_type>              received_blocks;
+    origin_index<transaction_origin, transaction_id_type>  received_transactions;
+    origin_index<transaction_request, transaction_id_type> req_trx;
+
+    uint64_t received_block_bytes = 0;  // size of the raw messages kept in received_blocks
+
+    uint64_t evicted_blocks       = 0;  // entries removed before the block or transaction was handled
+    uint64_t evicted_transactions = 0;
+    uint64_t evicted_requests     = 0;
 
     void bcast_transaction(const packed_transaction& msg);
     void rejected_transaction(const transaction_id_type& msg);
     void bcast_block(const signed_block& msg);
     void rejected_block(const block_id_type& id);
 
-    void recv_block(connection_ptr conn, const block_id_type& msg, uint32_t bnum);
+    void recv_block(connection_ptr conn, const block_id_type& msg, uint32_t bnum, send_buffer_ptr buffer);
     void recv_transaction(connection_ptr conn, const transaction_id_type& id);
     void recv_notice(connection_ptr conn, const notice_message& msg, bool generated);
 
     void retry_fetch(connection_ptr conn);
+
+    // remove the entries older than `deadline`, called periodically with the transaction check
+    void expire_origins(const time_point& deadline);
+
+private:
+    template <typename Index>
+    static uint64_t expire_index(Index& index, const time_point& deadline, size_t max_size);
+
+    // same as expire_index, but also bounds the total size of the kept raw messages
+    uint64_t expire_blocks(const time_point& deadline);
+    void     erase_block(decltype(received_blocks.begin()) it);
 };
 
 //---------------------------------------------------------------------------
@@ -744,6 +848,9 @@ connection::initialize() {
     auto* rnd = node_id.data();
     rnd[0]    = 0;
     response_expected.reset(new boost::asio::steady_timer(app().get_io_service()));
+    if(my_impl->net_workers && my_impl->net_workers->size() > 0) {
+        strand.reset(new boost::asio::io_service::strand(my_impl->net_workers->get_io_service()));
+    }
 }
 
 bool
@@ -790,12 +897,16 @@ connection::close() {
     fc_dlog(logger, "canceling wait on ${p}", ("p", peer_name()));
     cancel_wait();
     pending_message_buffer.reset();
+    read_session++;
+    queued_bytes    = 0;
+    queued_messages = 0;
+    read_paused     = false;
 }
 
 void
 connection::txn_send_pending(const vector<transaction_id_type>& ids) {
     for(auto tx = my_impl->local_txns.begin(); tx != my_impl->local_txns.end(); ++tx) {
-        if(tx->serialized_txn.size() && tx->block_num == 0) {
+        if(tx->serialized_txn && tx->block_num == 0) {
             bool found = false;
             for(auto known : ids) {
                 if(known == tx->id) {
@@ -805,7 +916,7 @@ connection::txn_send_pending(const vector<transaction_id_type>& ids) {
             }
             if(!found) {
                 my_impl->local_txns.modify(tx, incr_in_flight);
-                queue_write(std::make_shared<vector<char>>(tx->serialized_txn),
+                queue_write(tx->serialized_txn,
                             true,
                             [tx_id = tx->id](boost::system::error_code ec, std::size_t) {
                                 auto& local_txns = my_impl->local_txns;
@@ -826,9 +937,9 @@ void
 connection::txn_send(const vector<transaction_id_type>& ids) {
     for(auto t : ids) {
         auto tx = my_impl->local_txns.get<by_id>().find(t);
-        if(tx != my_impl->local_txns.end() && tx->serialized_txn.size()) {
+        if(tx != my_impl->local_txns.end() && tx->serialized_txn) {
             my_impl->local_txns.modify(tx, incr_in_flight);
-            queue_write(std::make_shared<vector<char>>(tx->serialized_txn),
+            queue_write(tx->serialized_txn,
                         true,
                         [t](boost::system::error_code ec, std::size_t) {
                             auto& local_txns = my_impl->local_txns;
@@ -991,8 +1102,8 @@ connection::send_time(const time_message& msg) {
 }
 
 void
-connection::queue_write(std::shared_ptr<vector<char>> buff,
-                        bool                          trigger_send,
+connection::queue_write(const send_buffer_ptr& buff,
+                        bool                   trigger_send,
                         std::function<void(boost::system::error_code, std::size_t)>
                             callback) {
     write_queue.push_back({buff, callback});
@@ -1094,7 +1205,7 @@ connection::enqueue_sync_block() {
     try {
         signed_block_ptr sb = cc.fetch_block_by_number(num);
         if(sb) {
-            enqueue(*sb, trigger_send);
+            enqueue_buffer(create_send_buffer(*sb), trigger_send);
             return true;
         }
     }
@@ -1111,16 +1222,11 @@ connection::enqueue(const net_message& m, bool trigger_send) {
         close_after_send = m.get<go_away_message>().reason;
     }
 
-    uint32_t payload_size = fc::raw::pack_size(m);
-    char*    header       = reinterpret_cast<char*>(&payload_size);
-    size_t   header_size  = sizeof(payload_size);
-
-    size_t buffer_size = header_size + payload_size;
+    enqueue_buffer(create_send_buffer(m), trigger_send, close_after_send);
+}
 
-    auto                  send_buffer = std::make_shared<vector<char>>(buffer_size);
-    fc::datastream<char*> ds(send_buffer->data(), buffer_size);
-    ds.write(header, header_size);
-    fc::raw::pack(ds, m);
+void
+connection::enqueue_buffer(const send_buffer_ptr& send_buffer, bool trigger_send, go_away_reason close_after_send) {
     connection_wptr weak_this = shared_from_this();
     queue_write(send_buffer, trigger_send,
                 [weak_this, close_after_send](boost::system::error_code ec, std::size_t) {
@@ -1238,9 +1344,12 @@ connection::process_next_message(net_plugin_impl& impl, uint32_t message_length)
         } while(uint8_t(b) & 0x80 && by < 32);
 
         if(which == uint64_t(net_message::tag<signed_block>::value)) {
-            blk_buffer.resize(message_length);
+            // keep the message with its header, so it can be relayed to other peers as it is
+            auto buff  = std::make_shared<vector<char>>(sizeof(message_length) + message_length);
             auto index = pending_message_buffer.read_index();
-            pending_message_buffer.peek(blk_buffer.data(), message_length, index);
+            memcpy(buff->data(), &message_length, sizeof(message_length));
+            pending_message_buffer.peek(buff->data() + sizeof(message_length), message_length, index);
+            blk_buffer = std::move(buff);
         }
         auto        ds = pending_message_buffer.create_datastream();
         net_message msg;
@@ -1256,6 +1365,94 @@ connection::process_next_message(net_plugin_impl& impl, uint32_t message_length)
     return true;
 }
 
+/**
+ * Context-free checks done on the net workers before the message is handed to the main thread.
+ * Returns false if the message should be dropped.
+ */
+static bool
+precheck_message(const net_message& msg) {
+    if(msg.contains<packed_transaction>()) {
+        // unpacks the transaction and caches it inside the message
+        auto& trx = msg.get<packed_transaction>();
+        if(fc::time_point(trx.expiration()) < fc::time_point::now()) {
+            fc_dlog(logger, "got an expired transaction - dropping");
+            return false;
+        }
+    }
+    return true;
+}
+
+void
+connection::queue_next_message(net_plugin_impl& impl, uint32_t message_length) {
+    // keep the header, so that a block message can be relayed as it is
+    auto buff = std::make_shared<vector<char>>(message_header_size + message_length);
+    memcpy(buff->data(), &message_length, message_header_size);
+    pending_message_buffer.read(buff->data() + message_header_size, message_length);
+
+    queued_bytes += buff->size();
+    queued_messages++;
+
+    connection_wptr weak_this = shared_from_this();
+    auto            session   = read_session;
+    strand->post([&impl, weak_this, session, buff] {
+        auto msg   = std::make_shared<net_message>();
+        auto error = optional<fc::exception>();
+        auto drop  = false;
+        try {
+            auto ds = fc::datastream<const char*>(buff->data() + message_header_size, buff->size() - message_header_size);
+            fc::raw::unpack(ds, *msg);
+            drop = !precheck_message(*msg);
+        }
+        catch(const fc::exception& e) {
+            error = e;
+        }
+
+        // always go back to the main thread, the message must be released from the backlog
+        app().get_io_service().post([&impl, weak_this, session, msg, buff, error, drop] {
+            auto c = weak_this.lock();
+            if(!c || c->read_session != session) {
+                return;
+            }
+            c->finish_queued_message(impl, buff->size());
+            if(error) {
+                edump((error->to_detail_string()));
+                impl.close(c);
+                return;
+            }
+            if(drop) {
+                return;
+            }
+            try {
+                if(msg->contains<signed_block>()) {
+                    c->blk_buffer = buff;
+                }
+                msgHandler m(impl, c);
+                msg->visit(m);
+            }
+            catch(const fc::exception& e) {
+                edump((e.to_detail_string()));
+                impl.close(c);
+            }
+        });
+    });
+}
+
+bool
+connection::read_backlog_full() const {
+    return queued_bytes >= def_max_read_bytes || queued_messages >= def_max_read_messages;
+}
+
+void
+connection::finish_queued_message(net_plugin_impl& impl, uint32_t message_size) {
+    queued_bytes -= message_size;
+    queued_messages--;
+    if(read_paused && !read_backlog_full()) {
+        read_paused = false;
+        fc_dlog(logger, "resume reading from ${p}", ("p", peer_name()));
+        impl.start_read_message(shared_from_this());
+    }
+}
+
 bool
 connection::add_peer_block(const peer_block_state &entry) {
     auto bptr = blk_state.get<by_id>().find(entry.id);
@@ -1658,17 +1855,19 @@ sync_manager::recv_block(connection_ptr c, const block_id_type& blk_id, uint32_t
 
 void
 dispatch_manager::bcast_block(const signed_block& bsum) {
-    connection_ptr skip;
-    for(auto org = received_blocks.begin(); org != received_blocks.end(); org++) {
-        if(org->id == bsum.id()) {
-            skip = org->origin;
-            received_blocks.erase(org);
-            break;
-        }
-    }
-    net_message    msg(bsum);
-    uint32_t       packsiz = fc::raw::pack_size(msg);
-    uint32_t       msgsiz  = packsiz + sizeof(packsiz);
+    connection_ptr  skip;
+    send_buffer_ptr buffer;
+    auto org = received_blocks.find(bsum.id());
+    if(org != received_blocks.end()) {
+        skip   = org->origin;
+        buffer = org->buffer;
+        erase_block(org);
+    }
+    // block is packed only once for all the peers, relayed block reuses the received message
+    if(!buffer) {
+        buffer = create_send_buffer(bsum);
+    }
+    uint32_t       msgsiz = buffer->size();
     notice_message pending_notify;
     block_id_type  bid               = bsum.id();
     uint32_t       bnum              = bsum.block_num();
@@ -1699,13 +1898,17 @@ dispatch_manager::bcast_block(const signed_block& bsum) {
                 continue;
             }
             cp->add_peer_block(pbstate);
-            cp->enqueue( bsum );
+            cp->enqueue_buffer(buffer);
         }
     }
 }
 
-void dispatch_manager::recv_block(connection_ptr c, const block_id_type& id, uint32_t bnum) {
-    received_blocks.emplace_back((block_origin){id, c});
+void dispatch_manager::recv_block(connection_ptr c, const block_id_type& id, uint32_t bnum, send_buffer_ptr buffer) {
+    auto r = received_blocks.insert((block_origin){id, c, std::move(buffer), time_point::now()});
+    if(r.second && r.first->buffer) {
+        received_block_bytes += r.first->buffer->size();
+    }
+    evicted_blocks += expire_blocks(time_point());
     if (c &&
         c->last_req &&
         c->last_req->req_blocks.mode != none &&
@@ -1720,61 +1923,65 @@ void dispatch_manager::recv_block(connection_ptr c, const block_id_type& id, uin
 
 void
 dispatch_manager::rejected_block(const block_id_type& id) {
-    fc_dlog(logger, "not sending rejected transaction ${tid}", ("tid", id));
-    for(auto org = received_blocks.begin(); org != received_blocks.end(); org++) {
-        if(org->id == id) {
-            received_blocks.erase(org);
-            break;
-        }
+    fc_dlog(logger, "not sending rejected block ${bid}", ("bid", id));
+    auto org = received_blocks.find(id);
+    if(org != received_blocks.end()) {
+        erase_block(org);
     }
 }
 
+void
+dispatch_manager::erase_block(decltype(received_blocks.begin()) it) {
+    if(it->buffer) {
+        received_block_bytes -= it->buffer->size();
+    }
+    received_blocks.erase(it);
+}
+
+uint64_t
+dispatch_manager::expire_blocks(const time_point& deadline) {
+    auto&    seq     = received_blocks.get<by_insertion>();
+    uint64_t evicted = 0;
+    while(!seq.empty() && (seq.size() > def_max_block_origins || received_block_bytes > def_max_block_buffers
+                           || seq.front().received < deadline)) {
+        erase_block(received_blocks.project<by_id>(seq.begin()));
+        evicted++;
+    }
+    return evicted;
+}
+
 void
 dispatch_manager::bcast_transaction(const packed_transaction& trx) {
     connection_ptr      skip;
     transaction_id_type id = trx.id();
 
-    for(auto org = received_transactions.begin(); org != received_transactions.end(); org++) {
-        if(org->id == id) {
-            skip = org->origin;
-            received_transactions.erase(org);
-            break;
-        }
-    }
-
-    for(auto ref = req_trx.begin(); ref != req_trx.end(); ++ref) {
-        if(*ref == id) {
-            req_trx.erase(ref);
-            break;
-        }
+    auto org = received_transactions.find(id);
+    if(org != received_transactions.end()) {
+        skip = org->origin;
+        received_transactions.erase(org);
     }
+    req_trx.erase(id);
 
     if(my_impl->local_txns.get<by_id>().find(id) != my_impl->local_txns.end()) {  //found
         fc_dlog(logger, "found trxid in local_trxs");
         return;
     }
-    uint32_t packsiz = 0;
-    uint32_t bufsiz  = 0;
-
     time_point_sec trx_expiration = trx.expiration();
 
-    net_message msg(trx);
-    packsiz = fc::raw::pack_size(msg);
-    bufsiz  = packsiz + sizeof(packsiz);
-    vector<char>          buff(bufsiz);
-    fc::datastream<char*> ds(buff.data(), bufsiz);
-    ds.write(reinterpret_cast<char*>(&packsiz), sizeof(packsiz));
-    fc::raw::pack(ds, msg);
+    // packed once, the same buffer is sent to all the peers and kept for later requests
+    auto   buff   = create_send_buffer(trx);
+    size_t bufsiz = buff->size();
+
     node_transaction_state nts = {id,
                                   trx_expiration,
                                   trx,
-                                  std::move(buff),
+                                  buff,
                                   0, 0, 0};
     my_impl->local_txns.insert(std::move(nts));
 
     if(!large_msg_notify || bufsiz <= just_send_it_max) {
         connection_wptr weak_skip = skip;
-        my_impl->send_all(trx, [weak_skip, id, trx_expiration](connection_ptr c) -> bool {
+        my_impl->send_all(buff, [weak_skip, id, trx_expiration](connection_ptr c) -> bool {
             if(c == weak_skip.lock() || c->syncing) {
                 return false;
             }
@@ -1818,7 +2025,8 @@ dispatch_manager::bcast_transaction(const packed_transaction& trx) {
 
 void
 dispatch_manager::recv_transaction(connection_ptr c, const transaction_id_type& id) {
-    received_transactions.emplace_back((transaction_origin){id, c});
+    received_transactions.insert((transaction_origin){id, c, time_point::now()});
+    evicted_transactions += expire_index(received_transactions, time_point(), def_max_trx_origins);
     if(c && c->last_req && c->last_req->req_trx.mode != none && c->last_req->req_trx.ids.back() == id) {
         c->last_req.reset();
     }
@@ -1830,11 +2038,36 @@ dispatch_manager::recv_transaction(connection_ptr c, const transaction_id_type&
 void
 dispatch_manager::rejected_transaction(const transaction_id_type& id) {
     fc_dlog(logger,"not sending rejected transaction ${tid}",("tid",id));
-    for(auto org = received_transactions.begin(); org != received_transactions.end(); org++) {
-        if(org->id == id) {
-            received_transactions.erase(org);
-            break;
-        }
+    received_transactions.erase(id);
+}
+
+template <typename Index>
+uint64_t
+dispatch_manager::expire_index(Index& index, const time_point& deadline, size_t max_size) {
+    auto&    seq     = index.template get<by_insertion>();
+    uint64_t evicted = 0;
+    while(!seq.empty() && (seq.size() > max_size || seq.front().received < deadline)) {
+        seq.pop_front();
+        evicted++;
+    }
+    return evicted;
+}
+
+void
+dispatch_manager::expire_origins(const time_point& deadline) {
+    auto blocks   = expire_blocks(deadline);
+    auto trxs     = expire_index(received_transactions, deadline, def_max_trx_origins);
+    auto requests = expire_index(req_trx, deadline, def_max_trx_origins);
+
+    evicted_blocks += blocks;
+    evicted_transactions += trxs;
+    evicted_requests += requests;
+    if(blocks + trxs + requests > 0) {
+        fc_dlog(logger, "expired origins of ${b} blocks, ${t} transactions and ${r} requests, "
+                        "tracking ${bs} blocks, ${ts} transactions and ${rs} requests, evicted ${eb}, ${et} and ${er} in total",
+                ("b", blocks)("t", trxs)("r", requests)
+                ("bs", received_blocks.size())("ts", received_transactions.size())("rs", req_trx.size())
+                ("eb", evicted_blocks)("et", evicted_transactions)("er", evicted_requests));
     }
 }
 
@@ -1861,7 +2094,8 @@ dispatch_manager::recv_notice(connection_ptr c, const notice_message& msg, bool
                                                         time_point()});
 
                 req.req_trx.ids.push_back(t);
-                req_trx.push_back(t);
+                req_trx.insert((transaction_request){t, time_point::now()});
+                evicted_requests += expire_index(req_trx, time_point(), def_max_trx_origins);
             }
             else {
                 fc_dlog(logger, "big msg manager found txn id in table, ${id}", ("id", t));
@@ -2152,7 +2386,10 @@ net_plugin_impl::start_read_message(connection_ptr conn) {
                                                           }
                                                           if(bytes_in_buffer >= message_length + message_header_size) {
                                                               conn->pending_message_buffer.advance_read_ptr(message_header_size);
-                                                              if(!conn->process_next_message(*this, message_length)) {
+                                                              if(conn->strand) {
+                                                                  conn->queue_next_message(*this, message_length);
+                                                              }
+                                                              else if(!conn->process_next_message(*this, message_length)) {
                                                                   return;
                                                               }
                                                           }
@@ -2162,6 +2399,12 @@ net_plugin_impl::start_read_message(connection_ptr conn) {
                                                           }
                                                       }
                                                   }
+                                                  if(conn->read_backlog_full()) {
+                                                      // stop reading until the queued messages are handled
+                                                      fc_dlog(logger, "pause reading from ${p}", ("p", conn->peer_name()));
+                                                      conn->read_paused = true;
+                                                      return;
+                                                  }
                                                   start_read_message(conn);
                                               }
                                               else {
@@ -2212,9 +2455,23 @@ net_plugin_impl::count_open_sockets() const {
 template <typename VerifierFunc>
 void
 net_plugin_impl::send_all(const net_message& msg, VerifierFunc verify) {
+    send_buffer_ptr buffer;
+    for(auto& c : connections) {
+        if(c->current() && verify(c)) {
+            if(!buffer) {
+                buffer = create_send_buffer(msg);
+            }
+            c->enqueue_buffer(buffer);
+        }
+    }
+}
+
+template <typename VerifierFunc>
+void
+net_plugin_impl::send_all(const send_buffer_ptr& buffer, VerifierFunc verify) {
     for(auto& c : connections) {
         if(c->current() && verify(c)) {
-            c->enqueue(msg);
+            c->enqueue_buffer(buffer);
         }
     }
 }
@@ -2556,6 +2813,7 @@ net_plugin_impl::handle_message(connection_ptr c, const signed_block& msg) {
 
     try {
         if(cc.fetch_block_by_id(blk_id)) {
+            c->blk_buffer.reset();
             sync_master->recv_block(c, blk_id, blk_num);
             return;
         }
@@ -2565,7 +2823,12 @@ net_plugin_impl::handle_message(connection_ptr c, const signed_block& msg) {
         elog("Caught an unknown exception trying to recall blockID");
     }
 
-    dispatcher->recv_block(c, blk_id, blk_num);
+    // the raw message is kept to relay the block, blocks received while syncing are too many to keep
+    auto buffer = std::move(c->blk_buffer);
+    if(sync_master->is_active(c)) {
+        buffer.reset();
+    }
+    dispatcher->recv_block(c, blk_id, blk_num, std::move(buffer));
     fc::microseconds age(fc::time_point::now() - msg.timestamp);
     fc_dlog(logger, "got signed_block #${n} from ${p} block age in secs = ${age}",
             ("n", blk_num)("p", c->peer_name())("age", age.to_seconds()));
@@ -2610,6 +2873,7 @@ net_plugin_impl::handle_message(connection_ptr c, const signed_block& msg) {
         sync_master->recv_block(c, blk_id, blk_num);
     }
     else {
+        dispatcher->rejected_block(blk_id);
         sync_master->rejected_block(c, blk_num);
     }
 }
@@ -2686,6 +2950,7 @@ net_plugin_impl::expire_txns() {
         auto& stale_blk = c->blk_state.get<by_block_num>();
         stale_blk.erase(stale_blk.lower_bound(1), stale_blk.upper_bound(bn));
     }
+    dispatcher->expire_origins(time_point::now() - fc::seconds(def_origin_expire_sec));
 }
 
 void
@@ -2927,6 +3192,7 @@ net_plugin::set_program_options(options_description& /*cli*/, options_descriptio
         ("connection-cleanup-period", bpo::value<int>()->default_value(def_conn_retry_wait), "number of seconds to wait before cleaning up dead connections")
         ("network-version-match", bpo::value<bool>()->default_value(false), "True to require exact match of peer network version.")
         ("sync-fetch-span", bpo::value<uint32_t>()->default_value(def_sync_fetch_span), "number of blocks to retrieve in a chunk from any individual peer during synchronization")
+        ("net-threads", bpo::value<uint16_t>()->default_value(def_net_threads), "Number of worker threads which decode and precheck the received messages, use 0 to decode them on the main thread")
         ("max-implicit-request", bpo::value<uint32_t>()->default_value(def_max_just_send), "maximum sizes of transaction or block messages that are sent without first sending a notice");
 }
 
@@ -2951,6 +3217,7 @@ net_plugin::plugin_initialize(const variables_map& options) {
     my->dispatcher->just_send_it_max = options.at("max-implicit-request").as<uint32_t>();
     my->max_client_count             = options.at("max-clients").as<int>();
     my->max_nodes_per_host           = options.at("p2p-max-nodes-per-host").as<int>();
+    my->net_workers.reset(new chain::thread_pool(options.at("net-threads").as<uint16_t>()));
 
     my->num_clients      = 0;
     my->started_sessions = 0;
@@ -3081,6 +3348,9 @@ net_plugin::plugin_shutdown() {
 
             my->acceptor.reset(nullptr);
         }
+        if(my->net_workers) {
+            my->net_workers->stop();
+        }
         ilog("exit shutdown");
     }
     FC_CAPTURE_AND_RETHROW()
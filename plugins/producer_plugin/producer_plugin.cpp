@@ -15,6 +15,7 @@
 #include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <algorithm>
+#include <deque>
 #include <boost/function_output_iterator.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
@@ -294,12 +295,58 @@ public:
                  ("confs", block->confirmed)("latency", (fc::time_point::now() - block->timestamp).count()/1000));
         }
     }
-      std::vector<std::tuple<packed_transaction_ptr, bool, next_function<transaction_trace_ptr>>> _pending_incoming_transactions;
+      std::vector<std::tuple<packed_transaction_ptr, transaction_metadata_ptr, bool, next_function<transaction_trace_ptr>>> _pending_incoming_transactions;
+      // transactions whose keys are being recovered, applied in the order they came in
+      std::deque<std::tuple<packed_transaction_ptr, transaction_metadata_ptr, bool, next_function<transaction_trace_ptr>>> _recovering_transactions;
 
 
     void
     on_incoming_transaction_async(const packed_transaction_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next) {
         chain::controller& chain = app().get_plugin<chain_plugin>().chain();
+
+        auto mtrx = transaction_metadata_ptr();
+        try {
+            mtrx = std::make_shared<transaction_metadata>(*trx);
+        }
+        CATCH_AND_CALL(next);
+        if(!mtrx) {
+            return;
+        }
+
+        // keys are recovered in the thread pool concurrently, then the transactions are pushed on main thread
+        // in the order they came in, a transaction may depend on the ones received before it
+        _recovering_transactions.emplace_back(trx, mtrx, persist_until_expired, next);
+
+        auto self = shared_from_this();
+        transaction_metadata::start_recover_keys(mtrx, chain.get_thread_pool(), chain.get_chain_id(), [self] {
+            app().get_io_service().post([self] {
+                self->process_recovered_transactions();
+            });
+        });
+    }
+
+    void
+    process_recovered_transactions() {
+        while(!_recovering_transactions.empty()) {
+            auto& f = std::get<1>(_recovering_transactions.front())->signing_keys_future;
+            if(f.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                return;
+            }
+            auto e = std::move(_recovering_transactions.front());
+            _recovering_transactions.pop_front();
+            process_incoming_transaction_async(std::get<0>(e), std::get<1>(e), std::get<2>(e), std::get<3>(e));
+        }
+    }
+
+    void
+    process_incoming_transaction_async(const packed_transaction_ptr& trx, const transaction_metadata_ptr& mtrx, bool persist_until_expired,
+                                       next_function<transaction_trace_ptr> next) {
+        chain::controller& chain = app().get_plugin<chain_plugin>().chain();
+        if(!chain.pending_block_state()) {
+            // no pending block now, it will be applied once the next block is started
+            _pending_incoming_transactions.emplace_back(trx, mtrx, persist_until_expired, next);
+            return;
+        }
         auto block_time = chain.pending_block_state()->header.timestamp.to_time_point();
 
         auto send_response = [this, &trx, &next](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& response) {
@@ -331,10 +378,10 @@ public:
         }
 
         try {
-            auto trace = chain.push_transaction(std::make_shared<transaction_metadata>(*trx), deadline);
+            auto trace = chain.push_transaction(mtrx, deadline);
             if(trace->except) {
                 if (failure_is_subjective(*trace->except, deadline_is_subjective)) {
-                    _pending_incoming_transactions.emplace_back(trx, persist_until_expired, next);
+                    _pending_incoming_transactions.emplace_back(trx, mtrx, persist_until_expired, next);
                 }
                 else {
                     auto e_ptr = trace->except->dynamic_copy_exception();
@@ -912,7 +959,8 @@ producer_plugin_impl::start_block() {
                 auto old_pending = std::move(_pending_incoming_transactions);
                 _pending_incoming_transactions.clear();
                 for(auto& e : old_pending) {
-                    on_incoming_transaction_async(std::get<0>(e), std::get<1>(e), std::get<2>(e));
+                    // keys are already recovered
+                    process_incoming_transaction_async(std::get<0>(e), std::get<1>(e), std::get<2>(e), std::get<3>(e));
                 }
             }
             return start_block_result::succeeded;